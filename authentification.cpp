@@ -18,7 +18,8 @@
     static const char *pwsalt = "$1$8282jdkmskwiu29291"; // $1$ for MD5
 #endif
 
-ApiAuth::ApiAuth()
+ApiAuth::ApiAuth() :
+    needSaveDatabase(false)
 {
 
 }
@@ -97,28 +98,36 @@ bool DeRestPluginPrivate::checkApikeyAuthentification(const ApiRequest &req, Api
         return false;
     }
 
-    std::vector<ApiAuth>::iterator i = apiAuths.begin();
-    std::vector<ApiAuth>::iterator end = apiAuths.end();
+    ApiAuth *apiAuth = getApiAuthForKey(apikey);
 
-    for (; i != end; ++i)
+    if (apiAuth)
     {
-        if (apikey == i->apikey)
+        QDateTime now = QDateTime::currentDateTimeUtc();
+
+        // coarse tracking, otherwise each request would require a database write
+        if (apiAuth->lastUseDate.secsTo(now) >= AUTH_LAST_USE_INTERVAL)
         {
-            i->lastUseDate = QDateTime::currentDateTimeUtc();
+            apiAuth->lastUseDate = now;
+            apiAuth->needSaveDatabase = true;
+            // no new config version, the last use date alone isn't worth events and cache rebuilds
+        }
 
-            // fill in useragent string if not already exist
-            if (i->useragent.isEmpty())
+        // fill in useragent string if not already exist
+        if (apiAuth->useragent.isEmpty())
+        {
+            if (req.hdr.hasKey("User-Agent"))
             {
-                if (req.hdr.hasKey("User-Agent"))
-                {
-                    i->useragent = req.hdr.value("User-Agent");
-                    DBG_Printf(DBG_HTTP, "set useragent '%s' for apikey '%s'\n", qPrintable(i->useragent), qPrintable(i->apikey));
-                }
+                apiAuth->useragent = req.hdr.value("User-Agent");
+                apiAuth->needSaveDatabase = true;
+                DBG_Printf(DBG_HTTP, "set useragent '%s' for apikey '%s'\n", qPrintable(apiAuth->useragent), qPrintable(apiAuth->apikey));
             }
+        }
 
+        if (apiAuth->needSaveDatabase)
+        {
             queSaveDb(DB_AUTH, DB_LONG_SAVE_DELAY);
-            return true;
         }
+        return true;
     }
 
     // allow non registered devices to use the api if the link button is pressed
@@ -129,7 +138,8 @@ bool DeRestPluginPrivate::checkApikeyAuthentification(const ApiRequest &req, Api
         auth.devicetype = "unknown";
         auth.createDate = QDateTime::currentDateTimeUtc();
         auth.lastUseDate = QDateTime::currentDateTimeUtc();
-        apiAuths.push_back(auth);
+        auth.needSaveDatabase = true;
+        addApiAuth(auth);
         queSaveDb(DB_AUTH, DB_SHORT_SAVE_DELAY);
         return true;
     }
@@ -163,3 +173,29 @@ QString DeRestPluginPrivate::encryptString(const QString &str)
 #endif // Q_OS_UNIX
         return str;
 }
+
+/*! Returns the ApiAuth for a apikey.
+    \return the ApiAuth or 0 if not found
+ */
+ApiAuth *DeRestPluginPrivate::getApiAuthForKey(const QString &apikey)
+{
+    QHash<QString, int>::const_iterator i = apiAuthIndex.find(apikey);
+
+    if (i != apiAuthIndex.end())
+    {
+        DBG_Assert(i.value() < (int)apiAuths.size());
+        return &apiAuths[i.value()];
+    }
+
+    return 0;
+}
+
+/*! Adds a ApiAuth and puts it into the apikey index.
+    The whitelist is part of the configuration, so its ETag changes.
+ */
+void DeRestPluginPrivate::addApiAuth(const ApiAuth &auth)
+{
+    apiAuthIndex.insert(auth.apikey, apiAuths.size());
+    apiAuths.push_back(auth);
+    updateConfigEtag();
+}
@@ -149,6 +149,7 @@ static int sqliteLoadAuthCallback(void *user, int ncols, char **colval , char **
     {
         auth.createDate = QDateTime::currentDateTimeUtc();
         auth.lastUseDate = QDateTime::currentDateTimeUtc();
+        auth.needSaveDatabase = true;
     }
 
     if (!auth.createDate.isValid())
@@ -166,7 +167,7 @@ static int sqliteLoadAuthCallback(void *user, int ncols, char **colval , char **
 
     if (!auth.apikey.isEmpty() && !auth.devicetype.isEmpty())
     {
-        d->apiAuths.push_back(auth);
+        d->addApiAuth(auth);
     }
 
     return 0;
@@ -417,7 +418,7 @@ static int sqliteLoadAllGroupsCallback(void *user, int ncols, char **colval , ch
         if (!g)
         {
             // append to cache if not already known
-            d->updateEtag(group.etag);
+            d->updateGroupEtag(&group);
             d->groups.push_back(group);
         }
     }
@@ -798,6 +799,12 @@ void DeRestPluginPrivate::saveDb()
 
         for (; i != end; ++i)
         {
+            // only write entries which have changed
+            if (!i->needSaveDatabase)
+            {
+                continue;
+            }
+
             DBG_Assert(i->createDate.timeSpec() == Qt::UTC);
             DBG_Assert(i->lastUseDate.timeSpec() == Qt::UTC);
 
@@ -820,6 +827,10 @@ void DeRestPluginPrivate::saveDb()
                     sqlite3_free(errmsg);
                 }
             }
+            else
+            {
+                i->needSaveDatabase = false;
+            }
         }
 
         saveDatabaseItems &= ~DB_AUTH;
@@ -38,11 +38,10 @@ void DeRestPluginPrivate::initOtau()
     otauNotifyIter = 0;
     otauNotifyDelay = deCONZ::appArgumentNumeric("--otau-notify-delay", OTAU_IDLE_TICKS_NOTIFY);
 
-    otauTimer = new QTimer(this);
-    otauTimer->setSingleShot(false);
-    connect(otauTimer, SIGNAL(timeout()),
-            this, SLOT(otauTimerFired()));
-    otauTimer->start(1000);
+    if (gwOtauActive)
+    {
+        scheduleJob(JobOtau, HOUSEKEEPING_TICK);
+    }
 }
 
 /*! Handler for incoming otau packets.
@@ -70,7 +69,7 @@ void DeRestPluginPrivate::otauDataIndication(const deCONZ::ApsDataIndication &in
     {
         if (otauBusyTicks <= 0)
         {
-            updateEtag(gwConfigEtag);
+            updateConfigEtag();
         }
 
         otauBusyTicks = OTAU_BUSY_TICKS;
@@ -165,7 +164,7 @@ void DeRestPluginPrivate::otauTimerFired()
 
         if (otauBusyTicks == 0)
         {
-            updateEtag(gwConfigEtag);
+            updateConfigEtag();
         }
     }
 
@@ -49,14 +49,17 @@ QMAKE_CXXFLAGS += -Wno-attributes
 HEADERS  = de_web_plugin.h \
            de_web_widget.h \
            json.h \
+           json_cache.h \
            colorspace.h \
            sqlite3.h \
            de_web_plugin_private.h \
            rest_node_base.h \
+           rest_router.h \
            light_node.h \
            group.h \
            group_info.h \
-           scene.h
+           scene.h \
+           zcl_codec.h
 
 SOURCES  = authentification.cpp \
            change_channel.cpp \
@@ -66,17 +69,24 @@ SOURCES  = authentification.cpp \
            de_web_widget.cpp \
            de_otau.cpp \
            json.cpp \
+           json_cache.cpp \
            colorspace.cpp \
            sqlite3.c \
+           rest_batch.cpp \
            rest_lights.cpp \
            rest_configuration.cpp \
+           rest_events.cpp \
            rest_groups.cpp \
            rest_schedules.cpp \
+           rest_router.cpp \
            rest_touchlink.cpp \
+           task_queue.cpp \
            upnp.cpp \
            zcl_tasks.cpp \
            gw_uuid.cpp \
+           housekeeping.cpp \
            permitJoin.cpp \
+           polling.cpp \
            rest_node_base.cpp \
            light_node.cpp \
            group.cpp \
@@ -14,19 +14,18 @@
 #include <QHttpRequestHeader>
 #include <QtPlugin>
 #include <QPushButton>
-#include <QTextCodec>
 #include <QTime>
 #include <QTimer>
 #include <QTcpSocket>
 #include <QHostAddress>
-#include <QUrl>
-#include <QCryptographicHash>
+#include <algorithm>
 #include <queue>
 #include "colorspace.h"
 #include "de_web_plugin.h"
 #include "de_web_plugin_private.h"
 #include "de_web_widget.h"
 #include "json.h"
+#include "zcl_codec.h"
 
 const char *HttpStatusOk           = "200 OK"; // OK
 const char *HttpStatusAccepted     = "202 Accepted"; // Accepted but not complete
@@ -37,6 +36,7 @@ const char *HttpStatusForbidden    = "403 Forbidden"; // Understand request but
 const char *HttpStatusNotFound     = "404 Not Found"; // Requested uri not found
 const char *HttpStatusServiceUnavailable = "503 Service Unavailable";
 const char *HttpStatusNotImplemented = "501 Not Implemented";
+const char *HttpStatusLengthRequired = "411 Length Required"; // Body without Content-Length
 const char *HttpContentHtml        = "text/html; charset=utf-8";
 const char *HttpContentCss         = "text/css";
 const char *HttpContentJson        = "application/json; charset=utf-8";
@@ -44,14 +44,15 @@ const char *HttpContentJS          = "text/javascript";
 const char *HttpContentPNG         = "image/png";
 const char *HttpContentJPG         = "image/jpg";
 const char *HttpContentSVG         = "image/svg+xml";
+const char *HttpContentEventStream = "text/event-stream";
 
 static int ReadAttributesDelay = 750;
 static int ReadAttributesLongDelay = 5000;
 static int ReadAttributesLongerDelay = 60000;
 static uint MaxGroupTasks = 4;
 
-ApiRequest::ApiRequest(const QHttpRequestHeader &h, const QStringList &p, QTcpSocket *s, const QString &c) :
-    hdr(h), path(p), sock(s), content(c), version(ApiVersion_1)
+ApiRequest::ApiRequest(const QHttpRequestHeader &h, const QStringList &p, QTcpSocket *s, const QByteArray &c) :
+    hdr(h), path(p), sock(s), content(c), batch(false), version(ApiVersion_1)
 {
     if (hdr.hasKey("Accept"))
     {
@@ -62,6 +63,20 @@ ApiRequest::ApiRequest(const QHttpRequestHeader &h, const QStringList &p, QTcpSo
     }
 }
 
+/*! Returns the parsed JSON body of a request.
+    \param ok - false if the body contains invalid JSON
+ */
+QVariant ApiRequest::json(bool &ok) const
+{
+    if (body.isValid())
+    {
+        ok = true;
+        return body;
+    }
+
+    return Json::parse(content, ok);
+}
+
 /*! Returns the apikey of a request or a empty string if not available
  */
 QString ApiRequest::apikey() const
@@ -74,6 +89,92 @@ QString ApiRequest::apikey() const
     return QString("");
 }
 
+/*! Fills the REST API route table.
+ */
+void DeRestPluginPrivate::initRestRoutes()
+{
+    const int Auth = RestRoute::NeedAuth;
+    const int NoAuth = RestRoute::NoFlags; // handler checks authentification if needed
+
+    // configuration
+    router.addRoute("POST",   "/api", &DeRestPluginPrivate::createUser, NoAuth);
+    router.addRoute("GET",    "/api/*", &DeRestPluginPrivate::getFullState, NoAuth);
+    router.addRoute("DELETE", "/api/config/password", &DeRestPluginPrivate::deletePassword, NoAuth);
+    router.addRoute("GET",    "/api/*/config", &DeRestPluginPrivate::getConfig, NoAuth);
+    router.addRoute("PUT",    "/api/*/config", &DeRestPluginPrivate::modifyConfig, NoAuth);
+    router.addRoute("POST",   "/api/*/config/update", &DeRestPluginPrivate::updateSoftware, NoAuth);
+    router.addRoute("POST",   "/api/*/config/updatefirmware", &DeRestPluginPrivate::updateFirmware, NoAuth);
+    router.addRoute("PUT",    "/api/*/config/password", &DeRestPluginPrivate::changePassword, NoAuth);
+    router.addRoute("GET",    "/api/*/changes", &DeRestPluginPrivate::getChanges, Auth);
+    router.addRoute("GET",    "/api/*/events", &DeRestPluginPrivate::getEvents, Auth);
+    router.addRoute("PUT",    "/api/*/batch", &DeRestPluginPrivate::handleBatch, Auth);
+    router.addRoute("GET",    "/api/*/polling", &DeRestPluginPrivate::getPollingState, Auth);
+
+    // lights
+    router.addRoute("GET",    "/api/*/lights", &DeRestPluginPrivate::getAllLights, Auth);
+    router.addRoute("POST",   "/api/*/lights", &DeRestPluginPrivate::searchLights, Auth);
+    router.addRoute("GET",    "/api/*/lights/new", &DeRestPluginPrivate::getNewLights, Auth);
+    router.addRoute("GET",    "/api/*/lights/*", &DeRestPluginPrivate::getLightState, Auth);
+    router.addRoute("PUT",    "/api/*/lights/*", &DeRestPluginPrivate::renameLight, Auth);
+    router.addRoute("PUT",    "/api/*/lights/*/state", &DeRestPluginPrivate::setLightState, Auth);
+    // same as rename above but this is what the hue app sends
+    router.addRoute("PUT",    "/api/*/lights/*/name", &DeRestPluginPrivate::renameLight, Auth);
+
+    // groups
+    router.addRoute("GET",    "/api/*/groups", &DeRestPluginPrivate::getAllGroups, Auth);
+    router.addRoute("POST",   "/api/*/groups", &DeRestPluginPrivate::createGroup, Auth);
+    router.addRoute("GET",    "/api/*/groups/*", &DeRestPluginPrivate::getGroupAttributes, Auth);
+    router.addRoute("PUT",    "/api/*/groups/*", &DeRestPluginPrivate::setGroupAttributes, Auth);
+    router.addRoute("DELETE", "/api/*/groups/*", &DeRestPluginPrivate::deleteGroup, Auth);
+    router.addRoute("PUT",    "/api/*/groups/*/action", &DeRestPluginPrivate::setGroupState, Auth);
+
+    // scenes
+    router.addRoute("POST",   "/api/*/groups/*/scenes", &DeRestPluginPrivate::createScene, Auth);
+    router.addRoute("GET",    "/api/*/groups/*/scenes", &DeRestPluginPrivate::getAllScenes, Auth);
+    router.addRoute("GET",    "/api/*/groups/*/scenes/*", &DeRestPluginPrivate::getSceneAttributes, Auth);
+    router.addRoute("PUT",    "/api/*/groups/*/scenes/*", &DeRestPluginPrivate::setSceneAttributes, Auth);
+    router.addRoute("DELETE", "/api/*/groups/*/scenes/*", &DeRestPluginPrivate::deleteScene, Auth);
+    router.addRoute("PUT",    "/api/*/groups/*/scenes/*/store", &DeRestPluginPrivate::storeScene, Auth);
+    router.addRoute("PUT",    "/api/*/groups/*/scenes/*/recall", &DeRestPluginPrivate::recallScene, Auth);
+
+    // schedules
+    router.addRoute("GET",    "/api/*/schedules", &DeRestPluginPrivate::getAllSchedules, NoAuth);
+    router.addRoute("POST",   "/api/*/schedules", &DeRestPluginPrivate::createSchedule, NoAuth);
+    router.addRoute("GET",    "/api/*/schedules/*", &DeRestPluginPrivate::getScheduleAttributes, NoAuth);
+    router.addRoute("PUT",    "/api/*/schedules/*", &DeRestPluginPrivate::setScheduleAttributes, NoAuth);
+    router.addRoute("DELETE", "/api/*/schedules/*", &DeRestPluginPrivate::deleteSchedule, NoAuth);
+
+    // touchlink
+    router.addRoute("POST",   "/api/*/touchlink/scan", &DeRestPluginPrivate::touchlinkScan, Auth);
+    router.addRoute("GET",    "/api/*/touchlink/scan", &DeRestPluginPrivate::getTouchlinkScanResults, Auth);
+    router.addRoute("POST",   "/api/*/touchlink/*/identify", &DeRestPluginPrivate::identifyLight, Auth);
+    router.addRoute("POST",   "/api/*/touchlink/*/reset", &DeRestPluginPrivate::resetLight, Auth);
+}
+
+/*! Calls the handler of a matched route.
+    \param route - the matched route
+    \param req - request data
+    \param rsp - response data
+    \return REQ_READY_SEND
+            REQ_NOT_HANDLED
+ */
+int DeRestPluginPrivate::handleApiRequest(const RestRoute *route, const ApiRequest &req, ApiResponse &rsp)
+{
+    DBG_Assert(route != 0);
+
+    if (!route)
+    {
+        return REQ_NOT_HANDLED;
+    }
+
+    if ((route->flags & RestRoute::NeedAuth) && !checkApikeyAuthentification(req, rsp))
+    {
+        return REQ_READY_SEND;
+    }
+
+    return (this->*(route->handler))(req, rsp);
+}
+
 /*! Constructor for pimpl.
     \param parent - the main plugin
  */
@@ -90,11 +191,27 @@ DeRestPluginPrivate::DeRestPluginPrivate(QObject *parent) :
     saveDatabaseItems = 0;
     sqliteDatabaseName = QDesktopServices::storageLocation(QDesktopServices::DataLocation);
     sqliteDatabaseName.append("/zll.db");
-    idleLimit = 0;
     idleTotalCounter = 0;
+    // seed versions with the startup time so they keep increasing across restarts
+    gwGeneration = QDateTime::currentMSecsSinceEpoch() * 1000;
+    gwConfigVersion = 0;
+    changeLogTrimmed = gwGeneration;
+    eventGeneration = gwGeneration;
+    eventPushPending = false;
     idleLastActivity = 0;
     udpSock = 0;
     gwGroupSendDelay = deCONZ::appArgumentNumeric("--group-delay", GROUP_SEND_DELAY);
+    gwHttpKeepAliveTimeout = deCONZ::appArgumentNumeric("--http-keepalive-timeout", HTTP_KEEP_ALIVE_TIMEOUT);
+    gwHttpKeepAliveMax = deCONZ::appArgumentNumeric("--http-keepalive-max", HTTP_KEEP_ALIVE_MAX);
+    readOrder = 0;
+    readPaceTime = 0;
+    groupcastCheck = false;
+    groupMembersDirty = true;
+    initPolling();
+    fullStateGeneration = 0;
+    fullStateApiVersion = ApiVersion_1;
+    fullStatePermitJoin = 0;
+    fullStateOtauBusy = false;
 
     gwLinkButton = false;
     gwOtauActive = false;
@@ -104,6 +221,7 @@ DeRestPluginPrivate::DeRestPluginPrivate(QObject *parent) :
 
     // starttime reference counts from here
     starttimeRef.start();
+    initHousekeeping(); // jobs might be scheduled while reading the database
 
     // default configuration
     gwRfConnected = false; // will be detected later
@@ -116,7 +234,7 @@ DeRestPluginPrivate::DeRestPluginPrivate(QObject *parent) :
     gwFirmwareNeedUpdate = false; // set later
     gwUpdateChannel = "stable";
     configToMap(gwConfig);
-    updateEtag(gwConfigEtag);
+    updateConfigEtag();
 
     // set some default might be overwritten by database
     gwAnnounceInterval = ANNOUNCE_INTERVAL;
@@ -149,29 +267,18 @@ DeRestPluginPrivate::DeRestPluginPrivate(QObject *parent) :
     connect(apsCtrl, SIGNAL(nodeEvent(deCONZ::NodeEvent)),
             this, SLOT(nodeEvent(deCONZ::NodeEvent)));
 
+    // started on demand for the next task deadline
     taskTimer = new QTimer(this);
-    taskTimer->setSingleShot(false);
+    taskTimer->setSingleShot(true);
     connect(taskTimer, SIGNAL(timeout()),
             this, SLOT(processTasks()));
-    taskTimer->start(100);
-
-    groupTaskTimer = new QTimer(this);
-    taskTimer->setSingleShot(false);
-    connect(taskTimer, SIGNAL(timeout()),
-            this, SLOT(processGroupTasks()));
-    taskTimer->start(250);
 
     lockGatewayTimer = new QTimer(this);
     lockGatewayTimer->setSingleShot(true);
     connect(lockGatewayTimer, SIGNAL(timeout()),
             this, SLOT(lockGatewayTimerFired()));
 
-    openClientTimer = new QTimer(this);
-    openClientTimer->setSingleShot(false);
-    connect(openClientTimer, SIGNAL(timeout()),
-            this, SLOT(openClientTimerFired()));
-    openClientTimer->start(1000);
-
+    initRestRoutes();
     initAuthentification();
     initInternetDicovery();
     initSchedules();
@@ -220,6 +327,15 @@ void DeRestPluginPrivate::apsdeDataIndication(const deCONZ::ApsDataIndication &i
             handleSceneClusterIndication(task, ind, zclFrame);
             break;
 
+        case ONOFF_CLUSTER_ID:
+        case LEVEL_CLUSTER_ID:
+        case COLOR_CLUSTER_ID:
+            if (zclFrame.isProfileWideCommand() && (zclFrame.commandId() == 0x0A)) // Report attributes
+            {
+                handleZclAttributeReportIndication(ind, zclFrame);
+            }
+            break;
+
         default:
             break;
         }
@@ -249,26 +365,15 @@ void DeRestPluginPrivate::apsdeDataIndication(const deCONZ::ApsDataIndication &i
  */
 void DeRestPluginPrivate::apsdeDataConfirm(const deCONZ::ApsDataConfirm &conf)
 {
-    std::list<TaskItem>::iterator i = runningTasks.begin();
-    std::list<TaskItem>::iterator end = runningTasks.end();
-
-    for (;i != end; ++i)
+    if (taskQueue.confirm(conf.id(), conf.status() == deCONZ::ApsSuccessStatus))
     {
-        TaskItem &task = *i;
-        if (task.req.id() == conf.id())
-        {
-            DBG_Printf(DBG_INFO_L2, "Erase task zclSequenceNumber: %u\n", task.zclFrame.sequenceNumber());
-            runningTasks.erase(i);
-            processTasks();
+        processTasks();
 
-            if (conf.status() != deCONZ::ApsSuccessStatus)
-            {
-                DBG_Printf(DBG_INFO, "error APSDE-DATA.confirm: 0x%02X on task\n", conf.status());
-            }
-            // TODO: check if some action shall be done based on confirm status
-
-            return;
+        if (conf.status() != deCONZ::ApsSuccessStatus)
+        {
+            DBG_Printf(DBG_INFO, "error APSDE-DATA.confirm: 0x%02X on task\n", conf.status());
         }
+        // TODO: check if some action shall be done based on confirm status
     }
 }
 
@@ -303,15 +408,98 @@ QVariantMap DeRestPluginPrivate::errorToMap(int id, const QString &ressource, co
     return map;
 }
 
-/*! Creates a new unique ETag for a resource.
+/*! Returns a new resource version.
+    All resources share one strictly increasing counter, so gwGeneration
+    always equals the version of the most recent change.
+ */
+quint64 DeRestPluginPrivate::nextVersion()
+{
+    return ++gwGeneration;
+}
+
+/*! Returns the ETag for a resource \p version.
  */
-void DeRestPluginPrivate::updateEtag(QString &etag)
+QString DeRestPluginPrivate::etagForVersion(quint64 version)
 {
-    QTime time = QTime::currentTime();
-    etag = QString(QCryptographicHash::hash(time.toString().toAscii(), QCryptographicHash::Md5).toHex());
     // quotes are mandatory as described in w3 spec
-    etag.prepend('"');
-    etag.append('"');
+    return QString("\"%1\"").arg(version);
+}
+
+/*! Marks a light as changed.
+ */
+void DeRestPluginPrivate::updateLightEtag(LightNode *lightNode)
+{
+    DBG_Assert(lightNode != 0);
+
+    if (lightNode)
+    {
+        lightNode->version = nextVersion();
+        lightNode->etag = etagForVersion(lightNode->version);
+        logChange(ResourceChange::TypeLight, lightNode->id(), lightNode->version);
+    }
+}
+
+/*! Marks a group as changed.
+ */
+void DeRestPluginPrivate::updateGroupEtag(Group *group)
+{
+    DBG_Assert(group != 0);
+
+    if (group)
+    {
+        group->version = nextVersion();
+        group->etag = etagForVersion(group->version);
+        logChange(ResourceChange::TypeGroup, group->id(), group->version);
+    }
+}
+
+/*! Marks the gateway configuration as changed.
+ */
+void DeRestPluginPrivate::updateConfigEtag()
+{
+    gwConfigVersion = nextVersion();
+    gwConfigEtag = etagForVersion(gwConfigVersion);
+    logChange(ResourceChange::TypeConfig, QString(), gwConfigVersion);
+}
+
+/*! Appends a resource change to the change log.
+    Consecutive changes of the same resource are merged into one entry.
+    If the log is full the oldest entry is dropped.
+    \param type - the resource type
+    \param id - the resource id
+    \param version - the new version of the resource
+ */
+void DeRestPluginPrivate::logChange(ResourceChange::Type type, const QString &id, quint64 version)
+{
+    if (!eventListeners.empty() && !eventPushPending)
+    {
+        // all changes of this event loop iteration are pushed in one event
+        eventPushPending = true;
+        QTimer::singleShot(0, this, SLOT(pushEventsTimerFired()));
+    }
+
+    if (!changeLog.empty())
+    {
+        ResourceChange &last = changeLog.back();
+
+        if ((last.type == type) && (last.id == id))
+        {
+            last.version = version;
+            return;
+        }
+    }
+
+    if (changeLog.size() >= CHANGE_LOG_MAX_SIZE)
+    {
+        changeLogTrimmed = changeLog.front().version;
+        changeLog.pop_front();
+    }
+
+    ResourceChange change;
+    change.version = version;
+    change.type = type;
+    change.id = id;
+    changeLog.push_back(change);
 }
 
 /*! Returns the system uptime in seconds.
@@ -359,17 +547,18 @@ LightNode *DeRestPluginPrivate::addNode(const deCONZ::Node *node)
             // refresh all with new values
             DBG_Printf(DBG_INFO, "LightNode %u: %s updated\n", lightNode.id().toUInt(), qPrintable(lightNode.name()));
             lightNode2->setIsAvailable(true);
-            lightNode2->setNextReadTime(QTime::currentTime().addMSecs(ReadAttributesLongDelay));
             lightNode2->enableRead(READ_MODEL_ID |
                                    READ_SWBUILD_ID |
                                    READ_COLOR |
                                    READ_LEVEL |
                                    READ_ON_OFF |
                                    READ_GROUPS |
-                                   READ_SCENES);
+                                   READ_SCENES |
+                                   CONFIGURE_REPORTING);
 
             lightNode2->setLastRead(idleTotalCounter);
-            updateEtag(lightNode2->etag);
+            scheduleRead(lightNode2, ReadAttributesLongDelay);
+            updateLightEtag(lightNode2);
         }
         return lightNode2;
     }
@@ -442,22 +631,25 @@ LightNode *DeRestPluginPrivate::addNode(const deCONZ::Node *node)
         }
 
         // force reading attributes
-        lightNode.setNextReadTime(QTime::currentTime().addMSecs(ReadAttributesLongDelay));
         lightNode.enableRead(READ_MODEL_ID |
                              READ_SWBUILD_ID |
                              READ_COLOR |
                              READ_LEVEL |
                              READ_ON_OFF |
                              READ_GROUPS |
-                             READ_SCENES);
+                             READ_SCENES |
+                             CONFIGURE_REPORTING);
         lightNode.setLastRead(idleTotalCounter);
 
         DBG_Printf(DBG_INFO, "LightNode %u: %s added\n", lightNode.id().toUInt(), qPrintable(lightNode.name()));
         nodes.push_back(lightNode);
         lightNode2 = &nodes.back();
+        groupMembersDirty = true; // LightNode pointers moved
 
-        p->startReadTimer(ReadAttributesDelay);
-        updateEtag(lightNode2->etag);
+        scheduleJob(JobGroupTasks, GROUP_TASK_PERIOD);
+
+        scheduleRead(lightNode2, ReadAttributesLongDelay);
+        updateLightEtag(lightNode2);
         return lightNode2;
     }
 
@@ -485,8 +677,7 @@ LightNode *DeRestPluginPrivate::nodeZombieStateChanged(const deCONZ::Node *node)
         if (lightNode->isAvailable() != available)
         {
             lightNode->setIsAvailable(available);
-            updateEtag(lightNode->etag);
-            updateEtag(gwConfigEtag);
+            updateLightEtag(lightNode);
         }
     }
 
@@ -661,8 +852,7 @@ LightNode *DeRestPluginPrivate::updateLightNode(const deCONZ::NodeEvent &event)
 
     if (updated)
     {
-        updateEtag(lightNode->etag);
-        updateEtag(gwConfigEtag);
+        updateLightEtag(lightNode);
     }
 
     return lightNode;
@@ -819,6 +1009,7 @@ GroupInfo *DeRestPluginPrivate::createGroupInfo(LightNode *lightNode, uint16_t i
     GroupInfo groupInfo;
     groupInfo.id = id;
     lightNode->groups().push_back(groupInfo);
+    groupMembersDirty = true;
 
     return &lightNode->groups().back();
 }
@@ -903,7 +1094,7 @@ bool DeRestPluginPrivate::processReadAttributes(LightNode *lightNode)
     }
 
     // check if read should happen now
-    if (lightNode->nextReadTime() > QTime::currentTime())
+    if (lightNode->readDue() > starttimeRef.elapsed())
     {
         return false;
     }
@@ -964,26 +1155,27 @@ bool DeRestPluginPrivate::processReadAttributes(LightNode *lightNode)
         }
     }
 
-    if (lightNode->mustRead(READ_MODEL_ID))
+    // attributes of the same cluster are read with one request,
+    // requests of different clusters are queued at once and sent back-to-back
     {
         std::vector<uint16_t> attributes;
-        attributes.push_back(0x0005); // Model identifier
+        uint32_t readFlags = 0;
 
-        if (readAttributes(lightNode, &lightNode->haEndpoint(), BASIC_CLUSTER_ID, attributes))
+        if (lightNode->mustRead(READ_MODEL_ID))
         {
-            lightNode->clearRead(READ_MODEL_ID);
-            processed++;
+            attributes.push_back(0x0005); // Model identifier
+            readFlags |= READ_MODEL_ID;
         }
-    }
 
-    if (lightNode->mustRead(READ_SWBUILD_ID))
-    {
-        std::vector<uint16_t> attributes;
-        attributes.push_back(0x4000); // Software build identifier
+        if (lightNode->mustRead(READ_SWBUILD_ID))
+        {
+            attributes.push_back(0x4000); // Software build identifier
+            readFlags |= READ_SWBUILD_ID;
+        }
 
-        if (readAttributes(lightNode, &lightNode->haEndpoint(), BASIC_CLUSTER_ID, attributes))
+        if (!attributes.empty() && readAttributes(lightNode, &lightNode->haEndpoint(), BASIC_CLUSTER_ID, attributes))
         {
-            lightNode->clearRead(READ_SWBUILD_ID);
+            lightNode->clearRead(readFlags);
             processed++;
         }
     }
@@ -1028,6 +1220,49 @@ bool DeRestPluginPrivate::processReadAttributes(LightNode *lightNode)
         }
     }
 
+    if (lightNode->mustRead(CONFIGURE_REPORTING))
+    {
+        int configured = 0;
+        int clusters = 0;
+
+        if (readOnOff)
+        {
+            clusters++;
+            if (configureReporting(lightNode, ONOFF_CLUSTER_ID))
+            {
+                configured++;
+            }
+        }
+
+        if (readLevel)
+        {
+            clusters++;
+            if (configureReporting(lightNode, LEVEL_CLUSTER_ID))
+            {
+                configured++;
+            }
+        }
+
+        if (readColor)
+        {
+            clusters++;
+            if (configureReporting(lightNode, COLOR_CLUSTER_ID))
+            {
+                configured++;
+            }
+        }
+
+        if (configured == clusters)
+        {
+            lightNode->clearRead(CONFIGURE_REPORTING);
+        }
+
+        if (configured > 0)
+        {
+            processed++;
+        }
+    }
+
     if (lightNode->mustRead(READ_GROUPS))
     {
         std::vector<uint16_t> groups; // empty meaning read all groups
@@ -1044,36 +1279,76 @@ bool DeRestPluginPrivate::processReadAttributes(LightNode *lightNode)
         std::vector<GroupInfo>::iterator end = lightNode->groups().end();
 
         int rd = 0;
+        int rejected = 0;
+        int waiting = -1; // seconds until the samples of a group time out
 
         for (; i != end; ++i)
         {
             Group *group = getGroupForId(i->id);
 
             DBG_Assert(group != 0);
-            if (group)
+            if (!group)
+            {
+                continue;
+            }
+
+            // scene tables are normally equal for all members of a group,
+            // so only a few members are queried as long as they agree
+            int age = idleTotalCounter - group->sceneDiscoveryTime;
+
+            if ((group->sceneDiscovery == Group::SceneDiscoveryNone) ||
+                ((group->sceneDiscovery != Group::SceneDiscoverySampling) && (age >= SCENE_DISCOVERY_MAX_AGE)))
+            {
+                // start a new sampling round
+                group->sceneDiscovery = Group::SceneDiscoverySampling;
+                group->sceneDiscoveryTime = idleTotalCounter;
+                group->sceneSampleLights.clear();
+                group->sceneSampleAnswers.clear();
+                group->sceneSample.clear();
+            }
+            else if (group->sceneDiscovery == Group::SceneDiscoveryDone)
+            {
+                continue; // known from the sampled members
+            }
+            else if ((group->sceneDiscovery == Group::SceneDiscoverySampling) &&
+                     ((int)group->sceneSampleLights.size() >= SCENE_DISCOVERY_SAMPLES))
             {
-                // NOTE: this may cause problems if we have a lot of nodes + groups
-                // proposal mark groups for which scenes where discovered
-                if (readSceneMembership(lightNode, group))
+                if (age < SCENE_DISCOVERY_TIMEOUT)
                 {
-                    rd++;
+                    // ask again when the samples time out, all members are queried if they disagree
+                    int remaining = SCENE_DISCOVERY_TIMEOUT - age;
+                    waiting = (waiting < 0) ? remaining : qMin(waiting, remaining);
+                    continue;
                 }
-                else
+
+                // responses got lost, sample this member instead
+                group->sceneDiscoveryTime = idleTotalCounter;
+                group->sceneSampleLights = group->sceneSampleAnswers;
+            }
+
+            if (readSceneMembership(lightNode, group))
+            {
+                if ((group->sceneDiscovery == Group::SceneDiscoverySampling) &&
+                    (std::find(group->sceneSampleLights.begin(), group->sceneSampleLights.end(), lightNode->address().ext()) == group->sceneSampleLights.end()))
                 {
-                    // print but don't take action
-                    DBG_Printf(DBG_INFO_L2, "read scenes membership for group: 0x%04X rejected\n", i->id);
+                    group->sceneSampleLights.push_back(lightNode->address().ext());
                 }
+                rd++;
+            }
+            else
+            {
+                // print but don't take action
+                DBG_Printf(DBG_INFO_L2, "read scenes membership for group: 0x%04X rejected\n", i->id);
+                rejected++;
             }
         }
 
-        if (!lightNode->groups().empty())
+        if (waiting >= 0)
         {
-            if (rd > 0)
-            {
-                lightNode->clearRead(READ_SCENES);
-            }
+            // the light might replace a lost sample
+            scheduleRead(lightNode, waiting * 1000);
         }
-        else
+        else if ((rd > 0) || (rejected == 0))
         {
             lightNode->clearRead(READ_SCENES);
         }
@@ -1084,6 +1359,122 @@ bool DeRestPluginPrivate::processReadAttributes(LightNode *lightNode)
     return (processed > 0);
 }
 
+/*! Returns true if a node has reads which processReadAttributes() can process.
+ */
+static bool hasPendingReads(const LightNode *lightNode)
+{
+    uint32_t flags = lightNode->readFlags();
+
+    if (lightNode->groups().empty())
+    {
+        flags &= ~READ_SCENES; // read after groups are known
+    }
+
+    return (flags != 0);
+}
+
+/*! Puts a node into the read queue.
+    Reads of a node are never processed before a given delay, so an earlier
+    due time of a node which is already queued is moved back, but a later
+    one is kept.
+    \param lightNode - the node with READ_* flags enabled
+    \param delay - ms until the reads are due
+ */
+void DeRestPluginPrivate::scheduleRead(LightNode *lightNode, int delay)
+{
+    DBG_Assert(lightNode != 0);
+    DBG_Assert(!nodes.empty() && (lightNode >= &nodes.front()) && (lightNode <= &nodes.back()));
+
+    if (!lightNode || nodes.empty() || (lightNode < &nodes.front()) || (lightNode > &nodes.back()))
+    {
+        return;
+    }
+
+    qint64 due = starttimeRef.elapsed() + delay;
+
+    if ((lightNode->readDue() >= 0) && (lightNode->readDue() >= due))
+    {
+        return;
+    }
+
+    // an outdated entry of the node stays in the queue and is skipped later
+    ReadDue entry;
+    entry.due = due;
+    entry.order = readOrder++;
+    entry.index = lightNode - &nodes.front();
+    lightNode->setReadDue(due);
+    readQueue.push(entry);
+    startReadQueueTimer();
+}
+
+/*! Processes the reads of the node which is due first.
+    Only one node is processed per ReadAttributesDelay. A node which has
+    more to read is queued again behind the nodes which are already due.
+    \return true if at least one attribute was processed
+ */
+bool DeRestPluginPrivate::processReadQueue()
+{
+    qint64 now = starttimeRef.elapsed();
+    bool processed = false;
+
+    while (!processed && (readPaceTime <= now) &&
+           !readQueue.empty() && (readQueue.top().due <= now))
+    {
+        ReadDue entry = readQueue.top();
+        readQueue.pop();
+
+        if ((entry.index >= nodes.size()) || (nodes[entry.index].readDue() != entry.due))
+        {
+            continue; // rescheduled
+        }
+
+        LightNode *lightNode = &nodes[entry.index];
+        lightNode->setReadDue(-1);
+
+        if (!lightNode->isAvailable() || !hasPendingReads(lightNode))
+        {
+            continue; // queued again when it becomes available
+        }
+
+        if (processReadAttributes(lightNode))
+        {
+            processed = true;
+            readPaceTime = now + ReadAttributesDelay;
+        }
+
+        if (hasPendingReads(lightNode))
+        {
+            // e.g. the task queue is full or groups are discovered later
+            scheduleRead(lightNode, processed ? ReadAttributesDelay : ReadAttributesLongDelay);
+        }
+    }
+
+    startReadQueueTimer();
+    return processed;
+}
+
+/*! (Re)starts the read timer for the earliest due node.
+    The timer isn't running while the read queue is empty.
+ */
+void DeRestPluginPrivate::startReadQueueTimer()
+{
+    // drop outdated entries so they don't cause extra wakeups
+    while (!readQueue.empty() &&
+           ((readQueue.top().index >= nodes.size()) || (nodes[readQueue.top().index].readDue() != readQueue.top().due)))
+    {
+        readQueue.pop();
+    }
+
+    if (readQueue.empty())
+    {
+        p->stopReadTimer();
+        return;
+    }
+
+    qint64 delay = qMax(readQueue.top().due, readPaceTime) - starttimeRef.elapsed();
+    p->startReadTimer((delay > 0) ? (int)delay : 0);
+}
+
 /*! Queue reading ZCL attributes of a node.
     \param lightNode the node from whch the attributes shall be read
     \param sd the simple descriptor for the endpoint of interrest
@@ -1129,10 +1520,135 @@ bool DeRestPluginPrivate::readAttributes(LightNode *lightNode, const deCONZ::Sim
         }
     }
 
-    { // ZCL frame
-        QDataStream stream(&task.req.asdu(), QIODevice::WriteOnly);
-        stream.setByteOrder(QDataStream::LittleEndian);
-        task.zclFrame.writeToStream(stream);
+    zclWriteFrame(task.req.asdu(),
+                  task.zclFrame.frameControl(),
+                  task.zclFrame.sequenceNumber(),
+                  task.zclFrame.commandId(),
+                  task.zclFrame.payload());
+
+    return addTask(task);
+}
+
+/*! Writes one attribute reporting configuration record of a Configure reporting
+    command for a discrete data type, which has no reportable change field.
+ */
+template <int Size>
+static void writeReportingConfig(ZclEncoder<Size> &stream, uint16_t attrId, uint8_t dataType)
+{
+    stream << (uint8_t)0x00; // direction: attribute is reported by the light
+    stream << attrId;
+    stream << dataType;
+    stream << (uint16_t)REPORT_MIN_INTERVAL;
+    stream << (uint16_t)REPORT_MAX_INTERVAL;
+}
+
+/*! Writes one attribute reporting configuration record of a Configure reporting
+    command for an analog data type, \p reportableChange must have its size.
+ */
+template <int Size, typename T>
+static void writeReportingConfig(ZclEncoder<Size> &stream, uint16_t attrId, uint8_t dataType, T reportableChange)
+{
+    writeReportingConfig(stream, attrId, dataType);
+    stream << reportableChange;
+}
+
+/*! Queue binding a cluster of a node to the gateway and configuring
+    attribute reporting for the light state attributes of the cluster.
+    A node only sends attribute reports to bound destinations, so both
+    requests are needed.
+    \param lightNode the node which shall report
+    \param clusterId ONOFF_CLUSTER_ID, LEVEL_CLUSTER_ID or COLOR_CLUSTER_ID
+    \return true if the requests are queued
+ */
+bool DeRestPluginPrivate::configureReporting(LightNode *lightNode, uint16_t clusterId)
+{
+    DBG_Assert(lightNode != 0);
+
+    if (!lightNode || !lightNode->isAvailable() || !apsCtrl)
+    {
+        return false;
+    }
+
+    quint64 gwAddress = apsCtrl->getParameter(deCONZ::ParamMacAddress);
+
+    if (gwAddress == 0)
+    {
+        return false;
+    }
+
+    TaskItem task;
+    task.taskType = TaskConfigureReporting;
+
+    task.req.setTxOptions(deCONZ::ApsTxAcknowledgedTransmission);
+    task.req.setDstEndpoint(lightNode->haEndpoint().endpoint());
+    task.req.setDstAddressMode(deCONZ::ApsExtAddress);
+    task.req.dstAddress() = lightNode->address();
+    task.req.setClusterId(clusterId);
+    task.req.setProfileId(HA_PROFILE_ID);
+    task.req.setSrcEndpoint(getSrcEndpoint(lightNode, task.req));
+
+    task.zclFrame.setSequenceNumber(zclSeq++);
+    task.zclFrame.setCommandId(0x06); // Configure reporting
+    task.zclFrame.setFrameControl(deCONZ::ZclFCProfileCommand |
+                             deCONZ::ZclFCDirectionClientToServer |
+                             deCONZ::ZclFCDisableDefaultResponse);
+
+    if (clusterId == ONOFF_CLUSTER_ID)
+    {
+        ZclEncoder<8> stream(task.zclFrame.payload());
+        writeReportingConfig(stream, 0x0000, 0x10); // OnOff, boolean
+    }
+    else if (clusterId == LEVEL_CLUSTER_ID)
+    {
+        ZclEncoder<9> stream(task.zclFrame.payload());
+        writeReportingConfig(stream, 0x0000, 0x20, (uint8_t)1); // Current level, uint8
+    }
+    else if (clusterId == COLOR_CLUSTER_ID)
+    {
+        ZclEncoder<38> stream(task.zclFrame.payload());
+        writeReportingConfig(stream, 0x0000, 0x20, (uint8_t)1); // Current hue, uint8
+        writeReportingConfig(stream, 0x0001, 0x20, (uint8_t)1); // Current saturation, uint8
+        writeReportingConfig(stream, 0x0003, 0x21, (uint16_t)16); // Current x, uint16
+        writeReportingConfig(stream, 0x0004, 0x21, (uint16_t)16); // Current y, uint16
+    }
+    else
+    {
+        return false;
+    }
+
+    zclWriteFrame(task.req.asdu(),
+                  task.zclFrame.frameControl(),
+                  task.zclFrame.sequenceNumber(),
+                  task.zclFrame.commandId(),
+                  task.zclFrame.payload());
+
+    TaskItem bindTask;
+    bindTask.taskType = TaskBind;
+
+    bindTask.req.setTxOptions(deCONZ::ApsTxAcknowledgedTransmission);
+    bindTask.req.setDstEndpoint(ZDO_ENDPOINT);
+    bindTask.req.setDstAddressMode(deCONZ::ApsExtAddress);
+    bindTask.req.dstAddress() = lightNode->address();
+    bindTask.req.setClusterId(ZDP_BIND_REQ_CLID);
+    bindTask.req.setProfileId(ZDP_PROFILE_ID);
+    bindTask.req.setSrcEndpoint(ZDO_ENDPOINT);
+
+    { // ZDP Bind_req, same little endian layout as ZCL payloads
+        ZclEncoder<22> stream(bindTask.req.asdu());
+        stream << (uint8_t)zclSeq++; // ZDP sequence number
+        stream << (quint64)lightNode->address().ext();
+        stream << (uint8_t)lightNode->haEndpoint().endpoint();
+        stream << clusterId;
+        stream << (uint8_t)0x03; // 64-bit destination address mode
+        stream << gwAddress;
+        stream << task.req.srcEndpoint();
+    }
+
+    // the task queue sends tasks of one destination in order, so the
+    // binding exists before reporting is configured
+    if (!addTask(bindTask))
+    {
+        return false;
     }
 
     return addTask(task);
@@ -1180,11 +1696,11 @@ bool DeRestPluginPrivate::readGroupMembership(LightNode *lightNode, const std::v
         }
     }
 
-    { // ZCL frame
-        QDataStream stream(&task.req.asdu(), QIODevice::WriteOnly);
-        stream.setByteOrder(QDataStream::LittleEndian);
-        task.zclFrame.writeToStream(stream);
-    }
+    zclWriteFrame(task.req.asdu(),
+                  task.zclFrame.frameControl(),
+                  task.zclFrame.sequenceNumber(),
+                  task.zclFrame.commandId(),
+                  task.zclFrame.payload());
 
     return addTask(task);
 }
@@ -1217,17 +1733,17 @@ void DeRestPluginPrivate::foundGroupMembership(LightNode *lightNode, uint16_t gr
 
     if (group)
     {
-        updateEtag(group->etag);
+        updateGroupEtag(group);
     }
 
-    updateEtag(lightNode->etag);
-    updateEtag(gwConfigEtag);
+    updateLightEtag(lightNode);
     lightNode->enableRead(READ_SCENES); // force reading of scene membership
+    scheduleRead(lightNode, 0);
 
     GroupInfo groupInfo;
     groupInfo.id = groupId;
     lightNode->groups().push_back(groupInfo);
-    markForPushUpdate(lightNode);
+    groupMembersDirty = true;
 }
 
 /*! Checks if the group is known in the global cache.
@@ -1257,7 +1773,7 @@ void DeRestPluginPrivate::foundGroup(uint16_t groupId)
     group.hueReal = 0.0f;
     group.sat = 128;
     group.setName(QString());
-    updateEtag(group.etag);
+    updateGroupEtag(&group);
     openDb();
     loadGroupFromDb(&group);
     closeDb();
@@ -1266,7 +1782,6 @@ void DeRestPluginPrivate::foundGroup(uint16_t groupId)
         queSaveDb(DB_GROUPS, DB_SHORT_SAVE_DELAY);
     }
     groups.push_back(group);
-    updateEtag(gwConfigEtag);
 }
 
 /*! Returns true if the \p lightNode is member of the group with the \p groupId.
@@ -1312,8 +1827,8 @@ void DeRestPluginPrivate::readAllInGroup(Group *group)
         if (isLightNodeInGroup(lightNode, group->address()))
         {
             // force reading attributes
-            lightNode->setNextReadTime(QTime::currentTime().addMSecs(ReadAttributesLongerDelay));
             lightNode->enableRead(READ_ON_OFF | READ_COLOR | READ_LEVEL);
+            scheduleRead(lightNode, ReadAttributesLongerDelay);
         }
     }
 }
@@ -1329,13 +1844,11 @@ void DeRestPluginPrivate::setAttributeOnOffGroup(Group *group, uint8_t onOff)
         return;
     }
 
-    bool changed = false;
     bool on = (onOff == 0x01);
     if (on != group->isOn())
     {
         group->setIsOn(on);
-        updateEtag(group->etag);
-        changed = true;
+        updateGroupEtag(group);
     }
 
     std::vector<LightNode>::iterator i = nodes.begin();
@@ -1349,17 +1862,11 @@ void DeRestPluginPrivate::setAttributeOnOffGroup(Group *group, uint8_t onOff)
             if (lightNode->isOn() != on)
             {
                 lightNode->setIsOn(on);
-                updateEtag(lightNode->etag);
-                changed = true;
+                updateLightEtag(lightNode);
             }
             setAttributeOnOff(lightNode);
         }
     }
-
-    if (changed)
-    {
-        updateEtag(gwConfigEtag);
-    }
 }
 
 /*! Get scene membership of a node for a group.
@@ -1393,21 +1900,98 @@ bool DeRestPluginPrivate::readSceneMembership(LightNode *lightNode, Group *group
                              deCONZ::ZclFCDisableDefaultResponse);
 
     { // payload
-        QDataStream stream(&task.zclFrame.payload(), QIODevice::WriteOnly);
-        stream.setByteOrder(QDataStream::LittleEndian);
-
+        ZclEncoder<2> stream(task.zclFrame.payload());
         stream << group->address();
     }
 
-    { // ZCL frame
-        QDataStream stream(&task.req.asdu(), QIODevice::WriteOnly);
-        stream.setByteOrder(QDataStream::LittleEndian);
-        task.zclFrame.writeToStream(stream);
-    }
+    zclWriteFrame(task.req.asdu(),
+                  task.zclFrame.frameControl(),
+                  task.zclFrame.sequenceNumber(),
+                  task.zclFrame.commandId(),
+                  task.zclFrame.payload());
 
     return addTask(task);
 }
 
+/*! Compares the scene membership response of a sampled group member with
+    the other samples of the group.
+    If SCENE_DISCOVERY_SAMPLES members (or all members of smaller groups)
+    agree, the scene membership is known for all members. Otherwise it is
+    queried from each member. Only the first response of each queried
+    member is counted.
+    \param group - the group
+    \param lightNode - the member which sent the response
+    \param scenes - the scene ids of the response
+ */
+void DeRestPluginPrivate::checkSceneSample(Group *group, LightNode *lightNode, std::vector<uint8_t> &scenes)
+{
+    DBG_Assert(group != 0);
+
+    if (!group || !lightNode || (group->sceneDiscovery != Group::SceneDiscoverySampling))
+    {
+        return;
+    }
+
+    quint64 extAddr = lightNode->address().ext();
+
+    if (std::find(group->sceneSampleLights.begin(), group->sceneSampleLights.end(), extAddr) == group->sceneSampleLights.end())
+    {
+        return; // not queried in this sampling round
+    }
+
+    if (std::find(group->sceneSampleAnswers.begin(), group->sceneSampleAnswers.end(), extAddr) != group->sceneSampleAnswers.end())
+    {
+        return; // already counted
+    }
+
+    std::sort(scenes.begin(), scenes.end());
+
+    if (group->sceneSampleAnswers.empty())
+    {
+        group->sceneSample = scenes;
+    }
+    else if (group->sceneSample != scenes)
+    {
+        DBG_Printf(DBG_INFO, "scenes of group 0x%04X differ between members, query each member\n", group->address());
+        group->sceneDiscovery = Group::SceneDiscoveryPerLight;
+        group->sceneDiscoveryTime = idleTotalCounter;
+
+        std::vector<LightNode>::iterator i = nodes.begin();
+        std::vector<LightNode>::iterator end = nodes.end();
+
+        for (; i != end; ++i)
+        {
+            if (i->isAvailable() && isLightNodeInGroup(&(*i), group->address()))
+            {
+                i->enableRead(READ_SCENES);
+                scheduleRead(&(*i), 0);
+            }
+        }
+        return;
+    }
+
+    group->sceneSampleAnswers.push_back(extAddr);
+
+    int members = 0;
+    std::vector<LightNode>::iterator i = nodes.begin();
+    std::vector<LightNode>::iterator end = nodes.end();
+
+    for (; i != end; ++i)
+    {
+        if (i->isAvailable() && isLightNodeInGroup(&(*i), group->address()))
+        {
+            members++;
+        }
+    }
+
+    if ((int)group->sceneSampleAnswers.size() >= qMin(members, SCENE_DISCOVERY_SAMPLES))
+    {
+        DBG_Printf(DBG_INFO, "scenes of group 0x%04X discovered from %d members\n", group->address(), (int)group->sceneSampleAnswers.size());
+        group->sceneDiscovery = Group::SceneDiscoveryDone;
+        group->sceneDiscoveryTime = idleTotalCounter;
+    }
+}
+
 /*! Checks if the scene membership is known to the group.
     If the scene is not known it will be added.
  */
@@ -1457,8 +2041,7 @@ void DeRestPluginPrivate::foundScene(LightNode *lightNode, Group *group, uint8_t
         scene.name.sprintf("Scene %u", sceneId);
     }
     group->scenes.push_back(scene);
-    updateEtag(group->etag);
-    updateEtag(gwConfigEtag);
+    updateGroupEtag(group);
     queSaveDb(DB_SCENES, DB_SHORT_SAVE_DELAY);
 }
 
@@ -1483,7 +2066,7 @@ void DeRestPluginPrivate::setSceneName(Group *group, uint8_t sceneId, const QStr
         {
             i->name = name;
             queSaveDb(DB_SCENES, DB_SHORT_SAVE_DELAY);
-            updateEtag(group->etag);
+            updateGroupEtag(group);
             break;
         }
     }
@@ -1542,8 +2125,7 @@ bool DeRestPluginPrivate::removeScene(Group *group, uint8_t sceneId)
             if (i->id == sceneId)
             {
                 i->state = Scene::StateDeleted;
-                updateEtag(group->etag);
-                updateEtag(gwConfigEtag);
+                updateGroupEtag(group);
                 break;
             }
         }
@@ -1600,18 +2182,16 @@ bool DeRestPluginPrivate::callScene(Group *group, uint8_t sceneId)
                              deCONZ::ZclFCDisableDefaultResponse);
 
     { // payload
-        QDataStream stream(&task.zclFrame.payload(), QIODevice::WriteOnly);
-        stream.setByteOrder(QDataStream::LittleEndian);
-
+        ZclEncoder<3> stream(task.zclFrame.payload());
         stream << group->address();
         stream << sceneId;
     }
 
-    { // ZCL frame
-        QDataStream stream(&task.req.asdu(), QIODevice::WriteOnly);
-        stream.setByteOrder(QDataStream::LittleEndian);
-        task.zclFrame.writeToStream(stream);
-    }
+    zclWriteFrame(task.req.asdu(),
+                  task.zclFrame.frameControl(),
+                  task.zclFrame.sequenceNumber(),
+                  task.zclFrame.commandId(),
+                  task.zclFrame.payload());
 
     if (addTask(task))
     {
@@ -1622,20 +2202,27 @@ bool DeRestPluginPrivate::callScene(Group *group, uint8_t sceneId)
 }
 
 /*! Queues a client for closing the connection.
+    If the client is already queued its timeout will be restarted.
     \param sock the client socket
     \param closeTimeout timeout in seconds then the socket should be closed
+    \return the queued client
  */
-void DeRestPluginPrivate::pushClientForClose(QTcpSocket *sock, int closeTimeout)
+TcpClient *DeRestPluginPrivate::pushClientForClose(QTcpSocket *sock, int closeTimeout)
 {
+    if (closeTimeout > 0)
+    {
+        scheduleJob(JobOpenClients, HOUSEKEEPING_TICK); // count down
+    }
+
     std::list<TcpClient>::iterator i = openClients.begin();
-    std::list<TcpClient>::iterator end = openClients.begin();
+    std::list<TcpClient>::iterator end = openClients.end();
 
     for ( ;i != end; ++i)
     {
         if (i->sock == sock)
         {
             i->closeTimeout = closeTimeout;
-            return;
+            return &(*i);
         }
         // Other QtcpSocket but same peer
         else if (i->sock->peerPort() == sock->peerPort())
@@ -1646,7 +2233,10 @@ void DeRestPluginPrivate::pushClientForClose(QTcpSocket *sock, int closeTimeout)
 
                 i->sock = sock;
                 i->closeTimeout = closeTimeout;
-                return;
+                i->requests = 0;
+                i->pending = false;
+                i->pendingBody.clear();
+                return &(*i);
             }
         }
     }
@@ -1654,60 +2244,193 @@ void DeRestPluginPrivate::pushClientForClose(QTcpSocket *sock, int closeTimeout)
     TcpClient client;
     client.sock = sock;
     client.closeTimeout = closeTimeout;
+    client.requests = 0;
+    client.pending = false;
 
     openClients.push_back(client);
+    return &openClients.back();
 }
 
-/*! Adds a task to the queue.
-    \return true - on success
+/*! Counts a request on a client connection and decides if the
+    connection shall be kept open after the response was sent.
+
+    HTTP/1.1 connections are persistent unless the client sends "Connection: close",
+    HTTP/1.0 connections only if the client asks for "Connection: keep-alive".
+    \param hdr - the http header of the request
+    \param sock - the client socket
+    \return true - if the connection will be kept alive
  */
-bool DeRestPluginPrivate::addTask(const TaskItem &task)
+bool DeRestPluginPrivate::checkKeepAlive(const QHttpRequestHeader &hdr, QTcpSocket *sock)
 {
-    if (!isInNetwork())
+    bool keepAlive = false;
+    QString connection = hdr.value("Connection").toLower();
+
+    if ((hdr.majorVersion() > 1) || ((hdr.majorVersion() == 1) && (hdr.minorVersion() >= 1)))
+    {
+        keepAlive = !connection.contains("close");
+    }
+    else
+    {
+        keepAlive = connection.contains("keep-alive");
+    }
+
+    if (gwHttpKeepAliveTimeout <= 0)
+    {
+        keepAlive = false;
+    }
+
+    TcpClient *client = pushClientForClose(sock, gwHttpKeepAliveTimeout);
+    client->requests++;
+
+    if (keepAlive && (gwHttpKeepAliveMax > 0) && (client->requests >= gwHttpKeepAliveMax))
+    {
+        DBG_Printf(DBG_HTTP, "HTTP max. requests reached for connection %s:%u\n", qPrintable(sock->peerAddress().toString()), sock->peerPort());
+        keepAlive = false;
+    }
+
+    if (!keepAlive)
+    {
+        client->closeTimeout = HTTP_CLOSE_TIMEOUT;
+    }
+
+    return keepAlive;
+}
+
+/*! Checks if a further complete request header is already buffered in \p sock (pipelining).
+    The data is only peeked, the caller must consume \p hdrLength bytes to process the request.
+    \param sock - the client socket
+    \param hdr - will be set to the parsed header
+    \param hdrLength - will be set to the length of the header in bytes
+    \return true - if a valid header was found
+ */
+bool DeRestPluginPrivate::peekPipelinedRequest(QTcpSocket *sock, QHttpRequestHeader &hdr, int &hdrLength)
+{
+    if (sock->state() != QTcpSocket::ConnectedState)
+    {
+        return false;
+    }
+
+    qint64 avail = sock->bytesAvailable();
+
+    if (avail < 4)
     {
         return false;
     }
 
-    const uint MaxTasks = 20;
+    QByteArray buf = sock->peek(qMin(avail, (qint64)MAX_HTTP_HEADER_SIZE));
+    int pos = buf.indexOf("\r\n\r\n");
 
-    std::list<TaskItem>::iterator i = tasks.begin();
-    std::list<TaskItem>::iterator end = tasks.end();
+    if (pos <= 0)
+    {
+        return false;
+    }
 
-    if ((task.taskType != TaskGetSceneMembership) &&
-        (task.taskType != TaskGetGroupMembership) &&
-        (task.taskType != TaskStoreScene) &&
-        (task.taskType != TaskRemoveScene) &&
-        (task.taskType != TaskReadAttributes))
+    hdr = QHttpRequestHeader(QString::fromLatin1(buf.constData(), pos + 4));
+
+    if (!hdr.isValid())
     {
-        for (; i != end; ++i)
-        {
-            if (i->taskType ==  task.taskType)
-            {
-                if ((i->req.dstAddress() ==  task.req.dstAddress()) &&
-                    (i->req.dstEndpoint() ==  task.req.dstEndpoint()) &&
-                    (i->req.srcEndpoint() ==  task.req.srcEndpoint()) &&
-                    (i->req.profileId() ==  task.req.profileId()) &&
-                    (i->req.clusterId() ==  task.req.clusterId()) &&
-                    (i->req.txOptions() ==  task.req.txOptions()) &&
-                    (i->req.asdu().size() ==  task.req.asdu().size()))
+        return false;
+    }
 
-                {
-                    DBG_Printf(DBG_INFO, "Replace task in queue cluster 0x%04X with newer task of same type\n", task.req.clusterId());
-                    *i = task;
-                    return true;
-                }
-            }
+    hdrLength = pos + 4;
+    return true;
+}
+
+/*! Reads the body of a request from \p sock.
+
+    The body is complete when Content-Length bytes were read. If less bytes
+    arrived yet the request is kept in the TcpClient of \p sock until the
+    rest of the body arrives, see takePendingRequest(). Bytes after the body
+    belong to the next pipelined request and stay in the socket.
+    \param hdr - http request header
+    \param sock - the client socket
+    \param content - the body received so far, will be completed
+    \return 1 - body is complete
+             0 - body is incomplete
+            -1 - PUT or POST request without Content-Length
+ */
+int DeRestPluginPrivate::readHttpBody(const QHttpRequestHeader &hdr, QTcpSocket *sock, QByteArray &content)
+{
+    if (!hdr.hasContentLength())
+    {
+        if ((hdr.method() == "PUT") || (hdr.method() == "POST"))
+        {
+            return -1; // end of the body is unknown
         }
+
+        return 1;
     }
 
-    if (tasks.size() < MaxTasks) {
-        tasks.push_back(task);
-        return true;
+    qint64 missing = (qint64)hdr.contentLength() - content.size();
+
+    if (missing > 0)
+    {
+        content.append(sock->read(missing));
+    }
+
+    if (content.size() < (int)hdr.contentLength())
+    {
+        DBG_Printf(DBG_HTTP, "HTTP wait for %d of %u body bytes\n", (int)hdr.contentLength() - content.size(), hdr.contentLength());
+        TcpClient *client = pushClientForClose(sock, HTTP_BODY_TIMEOUT);
+        client->pending = true;
+        client->pendingHdr = hdr;
+        client->pendingBody = content;
+        return 0;
+    }
+
+    return 1;
+}
+
+/*! Takes the request of \p sock which waits for the rest of its body.
+    \param sock - the client socket
+    \param hdr - will be set to the header of the request
+    \param content - will be set to the body received so far
+    \return true - if a request was pending
+ */
+bool DeRestPluginPrivate::takePendingRequest(QTcpSocket *sock, QHttpRequestHeader &hdr, QByteArray &content)
+{
+    std::list<TcpClient>::iterator i = openClients.begin();
+    std::list<TcpClient>::iterator end = openClients.end();
+
+    for (; i != end; ++i)
+    {
+        if ((i->sock == sock) && i->pending)
+        {
+            hdr = i->pendingHdr;
+            content = i->pendingBody;
+            i->pending = false;
+            i->pendingBody.clear();
+            return true;
+        }
     }
 
     return false;
 }
 
+/*! Adds a task to the queue.
+    \return true - on success
+ */
+bool DeRestPluginPrivate::addTask(const TaskItem &task)
+{
+    if (!isInNetwork())
+    {
+        return false;
+    }
+
+    if (!taskQueue.add(task))
+    {
+        return false;
+    }
+
+    if (task.lightNode && (TaskQueue::taskAttributes(task) != 0))
+    {
+        groupcastCheck = true;
+    }
+
+    startTaskTimer();
+    return true;
+}
+
 /*! Fills cluster, lightNode and node fields of \p task based on the information in \p ind.
     \return true - on success
  */
@@ -1753,7 +2476,7 @@ bool DeRestPluginPrivate::obtainTaskCluster(TaskItem &task, const deCONZ::ApsDat
     return true;
 }
 
-/*! Fires the next APS-DATA.request.
+/*! Fires the APS-DATA.requests of idle destinations.
  */
 void DeRestPluginPrivate::processTasks()
 {
@@ -1762,126 +2485,376 @@ void DeRestPluginPrivate::processTasks()
         return;
     }
 
-    if (tasks.empty())
+    if (taskQueue.expire() > 0)
     {
-        return;
+        updateConfigEtag(); // taskexpired counter
     }
 
-    if (!isInNetwork())
+    taskQueue.resumeParked();
+
+    if ((taskQueue.queuedCount() > 0) && !isInNetwork())
     {
-        DBG_Printf(DBG_INFO, "Not in network cleanup %d tasks\n", (runningTasks.size() + tasks.size()));
-        runningTasks.clear();
-        tasks.clear();
-        return;
+        DBG_Printf(DBG_INFO, "Not in network cleanup %d tasks\n", (taskQueue.runningCount() + taskQueue.queuedCount()));
+        taskQueue.clear();
     }
 
-    if (runningTasks.size() > 4)
+    if ((taskQueue.readyCount() > 0) && (taskQueue.runningCount() >= taskQueue.window()))
     {
-        DBG_Printf(DBG_INFO, "%d running tasks, wait\n", runningTasks.size());
-        return;
+        DBG_Printf(DBG_INFO, "%d running tasks, wait\n", taskQueue.runningCount());
     }
 
-    std::list<TaskItem>::iterator i = tasks.begin();
-    std::list<TaskItem>::iterator end = tasks.end();
+    if (groupcastCheck)
+    {
+        groupcastCheck = false;
+        promoteGroupcasts();
+    }
 
-    for (; i != end; ++i)
+    // visit each ready destination at most once, delayed ones are parked
+    int count = taskQueue.readyCount();
+    quint64 dst;
+
+    while ((count-- > 0) &&
+           (taskQueue.runningCount() < taskQueue.window()) &&
+           taskQueue.popReady(&dst))
     {
+        TaskItem *task = taskQueue.front(dst);
+
         // drop dead unicasts
-        if (i->lightNode && !i->lightNode->isAvailable())
+        if (task->lightNode && !task->lightNode->isAvailable())
         {
             DBG_Printf(DBG_INFO, "drop request to zombie\n");
-            tasks.erase(i);
-            return;
+            taskQueue.dropFront(dst);
+            continue;
         }
 
-        // send only one request to a destination at a time
-        std::list<TaskItem>::iterator j = runningTasks.begin();
-        std::list<TaskItem>::iterator jend = runningTasks.end();
+        Group *group = 0;
+        QTime now = QTime::currentTime();
 
-        bool ok = true;
-        for (; j != jend; ++j)
+        // groupcast tasks
+        if (task->req.dstAddressMode() == deCONZ::ApsGroupAddress)
         {
-            if (i->req.dstAddress() == j->req.dstAddress())
+            group = getGroupForId(task->req.dstAddress().group());
+
+            if (!group)
             {
-                ok = false;
-                break;
+                DBG_Printf(DBG_INFO, "drop request to unknown group 0x%04X\n", task->req.dstAddress().group());
+                taskQueue.dropFront(dst);
+                continue;
+            }
+
+            int diff = group->sendTime.msecsTo(now);
+
+            if (group->sendTime.isValid() && (diff > 0) && (diff <= gwGroupSendDelay))
+            {
+                DBG_Printf(DBG_INFO, "delayed group sending\n");
+                // wake up right when the group send delay is over
+                taskQueue.park(dst, gwGroupSendDelay - diff + 1);
+                continue;
             }
         }
 
-        if (!ok) // destination already busy
+        int ret = apsCtrl->apsdeDataRequest(task->req);
+
+        if (ret == deCONZ::Success)
         {
-            if (i->req.dstAddressMode() == deCONZ::ApsExtAddress)
+            if (group)
             {
-                DBG_Printf(DBG_INFO_L2, "delay sending request %u to %s\n", i->req.id(), qPrintable(i->req.dstAddress().toStringExt()));
+                group->sendTime = now;
             }
-            else if (i->req.dstAddressMode() == deCONZ::ApsGroupAddress)
+            taskQueue.startFront(dst);
+        }
+        else if (ret == deCONZ::ErrorNodeIsZombie)
+        {
+            DBG_Printf(DBG_INFO, "drop request to zombie\n");
+            taskQueue.dropFront(dst);
+        }
+        else
+        {
+            DBG_Printf(DBG_INFO, "enqueue APS request failed with error %d\n", ret);
+            taskQueue.park(dst, TASK_RETRY_DELAY);
+            break; // try again later
+        }
+    }
+
+    startTaskTimer();
+}
+
+/*! Replaces identical unicasts to several lights by groupcasts.
+
+    Ready lights whose queued tasks are equal are collected, if all known
+    lights of a group are among them the tasks are sent once to the group.
+    The largest group is taken first. Lights which are not covered by a
+    group keep their unicasts. Since groupcasts aren't acknowledged the
+    members which don't report their state are read back afterwards.
+    Called only after light state tasks were added, see addTask().
+ */
+void DeRestPluginPrivate::promoteGroupcasts()
+{
+    if (taskQueue.readyCount() < 2)
+    {
+        return;
+    }
+
+    std::vector<quint64> dsts;
+    taskQueue.readyDestinations(dsts);
+
+    // ready lights and their destination keys by queued commands
+    QHash<QByteArray, QHash<LightNode*, quint64> > commands;
+    std::vector<TaskItem*> queued;
+
+    std::vector<quint64>::const_iterator i = dsts.begin();
+    std::vector<quint64>::const_iterator end = dsts.end();
+
+    for (; i != end; ++i)
+    {
+        taskQueue.queuedTasks(*i, queued);
+
+        if (queued.empty())
+        {
+            continue;
+        }
+
+        LightNode *lightNode = queued.front()->lightNode;
+        QByteArray key;
+
+        std::vector<TaskItem*>::iterator qi = queued.begin();
+        std::vector<TaskItem*>::iterator qend = queued.end();
+
+        for (; qi != qend; ++qi)
+        {
+            TaskItem *t = *qi;
+
+            // only light state commands to available lights, the ZCL sequence number doesn't matter
+            if ((t->req.dstAddressMode() != deCONZ::ApsExtAddress) ||
+                !t->lightNode || (t->lightNode != lightNode) || !lightNode->isAvailable() ||
+                (TaskQueue::taskAttributes(*t) == 0))
             {
-                DBG_Printf(DBG_INFO, "delay sending request %u to group 0x%04X\n", i->req.id(), i->req.dstAddress().group());
+                key.clear();
+                break;
             }
+
+            key.append(QByteArray::number(t->taskType)).append(':');
+            key.append(QByteArray::number(t->req.profileId())).append(':');
+            key.append(QByteArray::number(t->req.clusterId())).append(':');
+            key.append(QByteArray::number(t->req.srcEndpoint())).append(':');
+            key.append(QByteArray::number(t->zclFrame.frameControl())).append(':');
+            key.append(QByteArray::number(t->zclFrame.commandId())).append(':');
+            key.append(t->zclFrame.payload().toHex()).append(';');
         }
-        else
+
+        if (!key.isEmpty())
         {
-            // groupcast tasks
-            if (i->req.dstAddressMode() == deCONZ::ApsGroupAddress)
+            commands[key].insert(lightNode, *i);
+        }
+    }
+
+    if (groupMembersDirty)
+    {
+        updateGroupMembers();
+    }
+
+    QHash<QByteArray, QHash<LightNode*, quint64> >::iterator c = commands.begin();
+    QHash<QByteArray, QHash<LightNode*, quint64> >::iterator cend = commands.end();
+
+    for (; c != cend; ++c)
+    {
+        QHash<LightNode*, quint64> &lights = c.value();
+
+        while (lights.size() >= 2)
+        {
+            Group *best = 0;
+            const std::vector<LightNode*> *bestMembers = 0;
+
+            QHash<uint16_t, std::vector<LightNode*> >::const_iterator g = groupMembers.constBegin();
+            QHash<uint16_t, std::vector<LightNode*> >::const_iterator gend = groupMembers.constEnd();
+
+            for (; g != gend; ++g)
             {
-                Group *group = getGroupForId(i->req.dstAddress().group());
+                const std::vector<LightNode*> &members = g.value();
 
-                if (group)
+                if ((members.size() < 2) || (bestMembers && (members.size() <= bestMembers->size())))
                 {
-                    QTime now = QTime::currentTime();
-                    int diff = group->sendTime.msecsTo(now);
+                    continue;
+                }
 
-                    if (!group->sendTime.isValid() || (diff <= 0) || (diff > gwGroupSendDelay))
-                    {
-                        if (apsCtrl->apsdeDataRequest(i->req) == deCONZ::Success)
-                        {
-                            group->sendTime = now;
-                            runningTasks.push_back(*i);
-                            tasks.erase(i);
-                            return;
-                        }
-                    }
-                    else
+                // each member must get the same commands
+                std::vector<LightNode*>::const_iterator m = members.begin();
+                std::vector<LightNode*>::const_iterator mend = members.end();
+
+                for (; m != mend; ++m)
+                {
+                    if (!lights.contains(*m))
                     {
-                        DBG_Printf(DBG_INFO, "delayed group sending\n");
+                        break;
                     }
                 }
+
+                if (m != mend)
+                {
+                    continue;
+                }
+
+                Group *group = getGroupForId(g.key());
+
+                if (group && (group->state() != Group::StateDeleted) && (group->address() != 0))
+                {
+                    best = group;
+                    bestMembers = &members;
+                }
             }
-            // unicast tasks
-            else
+
+            if (!best)
+            {
+                break;
+            }
+
+            // the group gets a copy of the tasks of one member
+            std::list<TaskItem> groupTasks;
+            uint attributes = 0;
+
+            taskQueue.queuedTasks(lights.value(bestMembers->front()), queued);
+
+            for (size_t k = 0; k < queued.size(); k++)
             {
-                if (i->lightNode && !i->lightNode->isAvailable())
+                TaskItem task = *queued[k];
+                attributes |= TaskQueue::taskAttributes(task);
+                task.lightNode = 0;
+                task.req.setTxOptions(0);
+                task.req.dstAddress() = deCONZ::Address();
+                task.req.dstAddress().setGroup(best->address());
+                task.req.setDstAddressMode(deCONZ::ApsGroupAddress);
+                task.req.setDstEndpoint(0xFF); // broadcast endpoint
+                groupTasks.push_back(task);
+            }
+
+            std::vector<LightNode*>::const_iterator m = bestMembers->begin();
+            std::vector<LightNode*>::const_iterator mend = bestMembers->end();
+
+            // keep the unicasts if the group queue is full
+            if (taskQueue.freeCount(TaskQueue::destinationKey(groupTasks.front().req)) < (int)groupTasks.size())
+            {
+                DBG_Printf(DBG_INFO, "No room to promote tasks to groupcast 0x%04X\n", best->address());
+
+                for (; m != mend; ++m)
                 {
-                    DBG_Printf(DBG_INFO, "drop request to zombie\n");
-                    tasks.erase(i);
-                    return;
+                    lights.remove(*m);
                 }
-                else
+                continue;
+            }
+
+            std::list<TaskItem>::const_iterator t = groupTasks.begin();
+            std::list<TaskItem>::const_iterator tend = groupTasks.end();
+
+            for (; t != tend; ++t)
+            {
+                if (!taskQueue.add(*t))
+                {
+                    break;
+                }
+            }
+
+            if (DBG_Assert(t == tend) == false)
+            {
+                // the members keep their unicasts, some commands might arrive twice
+                for (; m != mend; ++m)
                 {
-                    int ret = apsCtrl->apsdeDataRequest(i->req);
+                    lights.remove(*m);
+                }
+                continue;
+            }
+
+            DBG_Printf(DBG_INFO, "Promote %d tasks to %d lights to groupcast 0x%04X\n", (int)groupTasks.size(), (int)bestMembers->size(), best->address());
+
+            for (; m != mend; ++m)
+            {
+                quint64 dst = lights.take(*m);
+
+                while (taskQueue.front(dst))
+                {
+                    taskQueue.dropFront(dst);
+                }
 
-                    if (ret == deCONZ::Success)
+                // groupcasts aren't acknowledged, verify the new state of lights which don't report it anyway
+                if (!isReporting(*m))
+                {
+                    if (attributes & TASK_ATTR_ON_OFF)
                     {
-                        runningTasks.push_back(*i);
-                        tasks.erase(i);
-                        return;
+                        (*m)->enableRead(READ_ON_OFF);
                     }
-                    else if (ret == deCONZ::ErrorNodeIsZombie)
+                    if (attributes & TASK_ATTR_LEVEL)
                     {
-                        DBG_Printf(DBG_INFO, "drop request to zombie\n");
-                        tasks.erase(i);
-                        return;
+                        (*m)->enableRead(READ_LEVEL);
                     }
-                    else
+                    if (attributes & (TASK_ATTR_HUE | TASK_ATTR_SAT | TASK_ATTR_COLOR))
                     {
-                        DBG_Printf(DBG_INFO, "enqueue APS request failed with error %d\n", ret);
+                        (*m)->enableRead(READ_COLOR);
                     }
+                    scheduleRead(*m, ReadAttributesLongDelay);
                 }
             }
         }
     }
 }
 
+/*! Rebuilds the lights of each group used by promoteGroupcasts().
+
+    Groups with a pending add or remove action are left out, since a
+    groupcast would miss or wrongly reach some of their lights.
+ */
+void DeRestPluginPrivate::updateGroupMembers()
+{
+    groupMembers.clear();
+    groupMembersDirty = false;
+
+    std::vector<uint16_t> unsettled;
+
+    std::vector<LightNode>::iterator n = nodes.begin();
+    std::vector<LightNode>::iterator nend = nodes.end();
+
+    for (; n != nend; ++n)
+    {
+        std::vector<GroupInfo>::const_iterator i = n->groups().begin();
+        std::vector<GroupInfo>::const_iterator end = n->groups().end();
+
+        for (; i != end; ++i)
+        {
+            if (i->actions & (GroupInfo::ActionAddToGroup | GroupInfo::ActionRemoveFromGroup))
+            {
+                unsettled.push_back(i->id);
+            }
+            else if (i->state == GroupInfo::StateInGroup)
+            {
+                groupMembers[i->id].push_back(&(*n));
+            }
+        }
+    }
+
+    std::vector<uint16_t>::const_iterator u = unsettled.begin();
+    std::vector<uint16_t>::const_iterator uend = unsettled.end();
+
+    for (; u != uend; ++u)
+    {
+        groupMembers.remove(*u);
+    }
+}
+
+/*! (Re)starts the task timer for the next task deadline.
+    The timer isn't running while there is nothing to wait for.
+ */
+void DeRestPluginPrivate::startTaskTimer()
+{
+    qint64 delay = taskQueue.nextWakeup();
+
+    if (delay < 0)
+    {
+        taskTimer->stop();
+    }
+    else
+    {
+        taskTimer->start((int)delay);
+    }
+}
+
 /*! Handler for node events.
     \param event the event which occured
  */
@@ -1911,8 +2884,7 @@ void DeRestPluginPrivate::nodeEvent(const deCONZ::NodeEvent &event)
         if (lightNode)
         {
             lightNode->setIsAvailable(false);
-            updateEtag(lightNode->etag);
-            updateEtag(gwConfigEtag);
+            updateLightEtag(lightNode);
         }
     }
         break;
@@ -1958,7 +2930,7 @@ void DeRestPluginPrivate::processGroupTasks()
         return;
     }
 
-    if (tasks.size() > MaxGroupTasks)
+    if (taskQueue.queuedCount() > (int)MaxGroupTasks)
     {
         return;
     }
@@ -1995,6 +2967,7 @@ void DeRestPluginPrivate::processGroupTasks()
             if (addTaskAddToGroup(task, i->id))
             {
                 i->actions &= ~GroupInfo::ActionAddToGroup;
+                groupMembersDirty = true;
             }
             return;
         }
@@ -2004,6 +2977,7 @@ void DeRestPluginPrivate::processGroupTasks()
             if (addTaskRemoveFromGroup(task, i->id))
             {
                 i->actions &= ~GroupInfo::ActionRemoveFromGroup;
+                groupMembersDirty = true;
             }
             return;
         }
@@ -2054,10 +3028,7 @@ void DeRestPluginPrivate::handleGroupClusterIndication(TaskItem &task, const deC
     }
     else if (zclFrame.commandId() == 0x02) // Get group membership response
     {
-        DBG_Assert(zclFrame.payload().size() >= 2);
-
-        QDataStream stream(zclFrame.payload());
-        stream.setByteOrder(QDataStream::LittleEndian);
+        ZclDecoder stream(zclFrame.payload());
 
         uint8_t capacity;
         uint8_t count;
@@ -2065,16 +3036,21 @@ void DeRestPluginPrivate::handleGroupClusterIndication(TaskItem &task, const deC
         stream >> capacity;
         stream >> count;
 
+        if (!stream.isOk())
+        {
+            DBG_Printf(DBG_INFO, "invalid get group membership response\n");
+            return;
+        }
 
         lightNode->setGroupCapacity(capacity);
 
         for (uint i = 0; i < count; i++)
         {
-            if (!stream.atEnd())
-            {
-                uint16_t groupId;
-                stream >> groupId;
+            uint16_t groupId;
+            stream >> groupId;
 
+            if (stream.isOk())
+            {
                 DBG_Printf(DBG_INFO, "%s found group 0x%04X\n", qPrintable(lightNode->address().toStringExt()), groupId);
 
                 foundGroup(groupId);
@@ -2099,10 +3075,7 @@ void DeRestPluginPrivate::handleSceneClusterIndication(TaskItem &task, const deC
     }
     else if (zclFrame.commandId() == 0x06) // Get scene membership response
     {
-        DBG_Assert(zclFrame.payload().size() >= 4);
-
-        QDataStream stream(zclFrame.payload());
-        stream.setByteOrder(QDataStream::LittleEndian);
+        ZclDecoder stream(zclFrame.payload());
 
         uint8_t status;
         uint8_t capacity;
@@ -2113,7 +3086,11 @@ void DeRestPluginPrivate::handleSceneClusterIndication(TaskItem &task, const deC
         stream >> capacity;
         stream >> groupId;
 
-        if (status == deCONZ::ZclSuccessStatus)
+        if (!stream.isOk())
+        {
+            DBG_Printf(DBG_INFO, "invalid get scene membership response\n");
+        }
+        else if (status == deCONZ::ZclSuccessStatus)
         {
             Group *group = getGroupForId(groupId);
             LightNode *lightNode = getLightNodeForAddress(ind.srcAddress().ext());
@@ -2122,14 +3099,17 @@ void DeRestPluginPrivate::handleSceneClusterIndication(TaskItem &task, const deC
             DBG_Assert(lightNode != 0);
             stream >> count;
 
+            std::vector<uint8_t> scenes;
+
             for (uint i = 0; i < count; i++)
             {
-                if (!stream.atEnd())
-                {
-                    uint8_t sceneId;
-                    stream >> sceneId;
+                uint8_t sceneId;
+                stream >> sceneId;
 
+                if (stream.isOk())
+                {
                     DBG_Printf(DBG_INFO, "found scene 0x%02X for group 0x%04X\n", sceneId, groupId);
+                    scenes.push_back(sceneId);
 
                     if (group && lightNode)
                     {
@@ -2137,14 +3117,27 @@ void DeRestPluginPrivate::handleSceneClusterIndication(TaskItem &task, const deC
                     }
                 }
             }
+
+            if (group && lightNode && stream.isOk())
+            {
+                checkSceneSample(group, lightNode, scenes);
+            }
+        }
+        else
+        {
+            Group *group = getGroupForId(groupId);
+            LightNode *lightNode = getLightNodeForAddress(ind.srcAddress().ext());
+
+            if (group && lightNode)
+            {
+                std::vector<uint8_t> scenes; // e.g. the member lost the group
+                checkSceneSample(group, lightNode, scenes);
+            }
         }
     }
     else if (zclFrame.commandId() == 0x04) // Store scene response
     {
-        DBG_Assert(zclFrame.payload().size() >= 4);
-
-        QDataStream stream(zclFrame.payload());
-        stream.setByteOrder(QDataStream::LittleEndian);
+        ZclDecoder stream(zclFrame.payload());
 
         uint8_t status;
         uint16_t groupId;
@@ -2156,7 +3149,7 @@ void DeRestPluginPrivate::handleSceneClusterIndication(TaskItem &task, const deC
 
         LightNode *lightNode = getLightNodeForAddress(ind.srcAddress().ext());
 
-        if (lightNode)
+        if (lightNode && stream.isOk())
         {
             GroupInfo *groupInfo = getGroupInfo(lightNode, groupId);
 
@@ -2175,10 +3168,7 @@ void DeRestPluginPrivate::handleSceneClusterIndication(TaskItem &task, const deC
     }
     else if (zclFrame.commandId() == 0x02) // Remove scene response
     {
-        DBG_Assert(zclFrame.payload().size() >= 4);
-
-        QDataStream stream(zclFrame.payload());
-        stream.setByteOrder(QDataStream::LittleEndian);
+        ZclDecoder stream(zclFrame.payload());
 
         uint8_t status;
         uint16_t groupId;
@@ -2190,7 +3180,7 @@ void DeRestPluginPrivate::handleSceneClusterIndication(TaskItem &task, const deC
 
         LightNode *lightNode = getLightNodeForAddress(ind.srcAddress().ext());
 
-        if (lightNode)
+        if (lightNode && stream.isOk())
         {
             GroupInfo *groupInfo = getGroupInfo(lightNode, groupId);
 
@@ -2209,6 +3199,133 @@ void DeRestPluginPrivate::handleSceneClusterIndication(TaskItem &task, const deC
     }
 }
 
+/*! Handle ZCL Report attributes commands of the on/off, level and color cluster.
+    \param ind the APS level data indication containing the ZCL packet
+    \param zclFrame the actual ZCL frame which holds the attribute reports
+ */
+void DeRestPluginPrivate::handleZclAttributeReportIndication(const deCONZ::ApsDataIndication &ind, deCONZ::ZclFrame &zclFrame)
+{
+    if (!ind.srcAddress().hasExt())
+    {
+        return;
+    }
+
+    LightNode *lightNode = getLightNodeForAddress(ind.srcAddress().ext());
+
+    if (!lightNode)
+    {
+        return;
+    }
+
+    bool updated = false;
+    ZclDecoder stream(zclFrame.payload());
+
+    while (!stream.atEnd())
+    {
+        uint16_t attrId;
+        uint8_t dataType;
+
+        stream >> attrId;
+        stream >> dataType;
+
+        int size = zclDataTypeSize(dataType);
+
+        if (!stream.isOk() || (size == 0))
+        {
+            // can't skip the value, ignore remaining reports
+            DBG_Printf(DBG_INFO, "unsupported attribute report cluster 0x%04X attribute 0x%04X type 0x%02X\n", ind.clusterId(), attrId, dataType);
+            break;
+        }
+
+        quint64 value = 0;
+
+        for (int i = 0; i < size; i++)
+        {
+            uint8_t byte;
+            stream >> byte;
+            value |= ((quint64)byte << (8 * i));
+        }
+
+        if (!stream.isOk())
+        {
+            DBG_Printf(DBG_INFO, "invalid attribute report\n");
+            break;
+        }
+
+        if (ind.clusterId() == ONOFF_CLUSTER_ID)
+        {
+            if (attrId == 0x0000) // OnOff
+            {
+                bool on = (value != 0);
+                if (lightNode->isOn() != on)
+                {
+                    lightNode->setIsOn(on);
+                    updated = true;
+                }
+            }
+        }
+        else if (ind.clusterId() == LEVEL_CLUSTER_ID)
+        {
+            if (attrId == 0x0000) // Current level
+            {
+                uint8_t level = (uint8_t)value;
+                if (lightNode->level() != level)
+                {
+                    lightNode->setLevel(level);
+                    updated = true;
+                }
+            }
+        }
+        else if (ind.clusterId() == COLOR_CLUSTER_ID)
+        {
+            if (attrId == 0x0000) // Current hue
+            {
+                uint8_t hue = (value > 254) ? 254 : (uint8_t)value;
+                if (lightNode->hue() != hue)
+                {
+                    lightNode->setHue(hue);
+                    updated = true;
+                }
+            }
+            else if (attrId == 0x0001) // Current saturation
+            {
+                uint8_t sat = (uint8_t)value;
+                if (lightNode->saturation() != sat)
+                {
+                    lightNode->setSaturation(sat);
+                    updated = true;
+                }
+            }
+            else if (attrId == 0x0003) // Current x
+            {
+                uint16_t x = (uint16_t)value;
+                if (lightNode->colorX() != x)
+                {
+                    lightNode->setColorXY(x, lightNode->colorY());
+                    updated = true;
+                }
+            }
+            else if (attrId == 0x0004) // Current y
+            {
+                uint16_t y = (uint16_t)value;
+                if (lightNode->colorY() != y)
+                {
+                    lightNode->setColorXY(lightNode->colorX(), y);
+                    updated = true;
+                }
+            }
+        }
+    }
+
+    // reports replace polling as long as they keep coming
+    lightNode->setLastReport(idleTotalCounter);
+
+    if (updated)
+    {
+        updateLightEtag(lightNode);
+    }
+}
+
 /*! Handle the case than a node (re)joins the network.
     \param ind a ZDP DeviceAnnce_req
  */
@@ -2229,35 +3346,24 @@ void DeRestPluginPrivate::handleDeviceAnnceIndication(const deCONZ::ApsDataIndic
     if (!lightNode->isAvailable())
     {
         lightNode->setIsAvailable(true);
-        updateEtag(gwConfigEtag);
+        updateLightEtag(lightNode);
     }
 
     DBG_Printf(DBG_INFO, "DeviceAnnce %s\n", qPrintable(lightNode->name()));
 
     // force reading attributes
-    lightNode->setNextReadTime(QTime::currentTime().addMSecs(ReadAttributesLongDelay));
     lightNode->enableRead(READ_MODEL_ID |
                           READ_SWBUILD_ID |
                           READ_COLOR |
                           READ_LEVEL |
                           READ_ON_OFF |
                           READ_GROUPS |
-                          READ_SCENES);
+                          READ_SCENES |
+                          CONFIGURE_REPORTING);
     lightNode->setSwBuildId(QString()); // might be changed due otau
     lightNode->setLastRead(idleTotalCounter);
-    updateEtag(lightNode->etag);
-}
-
-/*! Mark node so current state will be pushed to all clients.
- */
-void DeRestPluginPrivate::markForPushUpdate(LightNode *lightNode)
-{
-    std::list<LightNode*>::iterator i = std::find(broadCastUpdateNodes.begin(), broadCastUpdateNodes.end(), lightNode);
-
-    if (i == broadCastUpdateNodes.end())
-    {
-        broadCastUpdateNodes.push_back(lightNode);
-    }
+    scheduleRead(lightNode, ReadAttributesLongDelay);
+    updateLightEtag(lightNode);
 }
 
 /*! Push data from a task into all LightNodes of a group or single LightNode.
@@ -2311,7 +3417,7 @@ void DeRestPluginPrivate::taskToLocalData(const TaskItem &task)
     switch (task.taskType)
     {
     case TaskSetOnOff:
-        updateEtag(group->etag);
+        updateGroupEtag(group);
         group->setIsOn(task.onOff);
         break;
 
@@ -2324,30 +3430,30 @@ void DeRestPluginPrivate::taskToLocalData(const TaskItem &task)
         {
             group->setIsOn(false);
         }
-        updateEtag(group->etag);
+        updateGroupEtag(group);
         group->level = task.level;
         break;
 
     case TaskSetSat:
-        updateEtag(group->etag);
+        updateGroupEtag(group);
         group->sat = task.sat;
         break;
 
     case TaskSetEnhancedHue:
-        updateEtag(group->etag);
+        updateGroupEtag(group);
         group->hue = task.hue;
         group->hueReal = task.hueReal;
         break;
 
     case TaskSetHueAndSaturation:
-        updateEtag(group->etag);
+        updateGroupEtag(group);
         group->sat = task.sat;
         group->hue = task.hue;
         group->hueReal = task.hueReal;
         break;
 
     case TaskSetXyColor:
-        updateEtag(group->etag);
+        updateGroupEtag(group);
         group->colorX = task.colorX;
         group->colorY = task.colorY;
         break;
@@ -2363,7 +3469,7 @@ void DeRestPluginPrivate::taskToLocalData(const TaskItem &task)
         switch (task.taskType)
         {
         case TaskSetOnOff:
-            updateEtag(lightNode->etag);
+            updateLightEtag(lightNode);
             lightNode->setIsOn(task.onOff);
             setAttributeOnOff(lightNode);
             break;
@@ -2377,26 +3483,26 @@ void DeRestPluginPrivate::taskToLocalData(const TaskItem &task)
             {
                 lightNode->setIsOn(false);
             }
-            updateEtag(lightNode->etag);
+            updateLightEtag(lightNode);
             lightNode->setLevel(task.level);
             setAttributeLevel(lightNode);
             setAttributeOnOff(lightNode);
             break;
 
         case TaskSetSat:
-            updateEtag(lightNode->etag);
+            updateLightEtag(lightNode);
             lightNode->setSaturation(task.sat);
             setAttributeSaturation(lightNode);
             break;
 
         case TaskSetEnhancedHue:
-            updateEtag(lightNode->etag);
+            updateLightEtag(lightNode);
             lightNode->setEnhancedHue(task.enhancedHue);
             setAttributeEnhancedHue(lightNode);
             break;
 
         case TaskSetHueAndSaturation:
-            updateEtag(lightNode->etag);
+            updateLightEtag(lightNode);
             lightNode->setSaturation(task.sat);
             lightNode->setEnhancedHue(task.enhancedHue);
             setAttributeSaturation(lightNode);
@@ -2404,7 +3510,7 @@ void DeRestPluginPrivate::taskToLocalData(const TaskItem &task)
             break;
 
         case TaskSetXyColor:
-            updateEtag(lightNode->etag);
+            updateLightEtag(lightNode);
             lightNode->setColorXY(task.colorX, task.colorY);
             setAttributeColorXy(lightNode);
             break;
@@ -2627,6 +3733,7 @@ DeRestPlugin::DeRestPlugin(QObject *parent) :
         lightNode.setHaEndpoint(haEndpoint);
 
         d->nodes.push_back(lightNode);
+        d->groupMembersDirty = true;
     }
 #endif // dummy node
 }
@@ -2651,59 +3758,17 @@ void DeRestPlugin::nodeEvent(int event, const deCONZ::Node *node)
 
 /*! Handle idle states.
 
-    After IDLE_LIMIT seconds user inactivity this timer
-    checks if nodes need to be refreshed. This is the case
-    if a node was not refreshed for IDLE_READ_LIMIT seconds.
+    Called once per second, refreshes the lights which need it most
+    within the polling budget, see DeRestPluginPrivate::pollLights().
  */
 void DeRestPlugin::idleTimerFired()
 {
     d->idleTotalCounter++;
     d->idleLastActivity++;
-
-    if (d->idleLimit > 0)
-    {
-        d->idleLimit--;
-    }
-
-    if (d->idleLastActivity < IDLE_USER_LIMIT)
-    {
-        return;
-    }
-
-    if (d->idleLimit <= 0)
-    {
-
-        DBG_Printf(DBG_INFO, "Idle timer triggered\n");
-        std::vector<LightNode>::iterator i = d->nodes.begin();
-        std::vector<LightNode>::iterator end = d->nodes.end();
-
-        for (; i != end; ++i)
-        {
-            if (i->lastRead() < (d->idleTotalCounter - IDLE_READ_LIMIT))
-            {
-                i->enableRead(READ_ON_OFF | READ_LEVEL | READ_COLOR | READ_GROUPS | READ_SCENES);
-
-                if (i->modelId().isEmpty())
-                {
-                    i->enableRead(READ_MODEL_ID);
-                }
-                if (i->swBuildId().isEmpty())
-                {
-                    i->enableRead(READ_SWBUILD_ID);
-                }
-                i->setLastRead(d->idleTotalCounter);
-                DBG_Printf(DBG_INFO, "Force read attributes for node %s\n", qPrintable(i->name()));
-                break;
-            }
-        }
-
-        startReadTimer(ReadAttributesDelay);
-
-        d->idleLimit = IDLE_LIMIT;
-    }
+    d->pollLights();
 }
 
-/*! Refresh all nodes by forcing the idle timer to trigger.
+/*! Refresh all nodes as fast as the polling budget allows.
  */
 void DeRestPlugin::refreshAll()
 {
@@ -2712,14 +3777,13 @@ void DeRestPlugin::refreshAll()
 
     for (; i != end; ++i)
     {
-        // force refresh on next idle timer timeout
-        i->setLastRead(d->idleTotalCounter - (IDLE_READ_LIMIT + 1));
+        // due for a refresh, reporting lights too
+        i->setLastRead(d->idleTotalCounter - (POLL_REPORTING_AGE + 1));
     }
 
-    d->idleLimit = 0;
     d->idleLastActivity = IDLE_USER_LIMIT;
-    d->runningTasks.clear();
-    d->tasks.clear();
+    d->pollCredit = POLL_MAX_CREDIT * 100;
+    d->taskQueue.clear();
 }
 
 /*! Starts the read attributes timer with a given \p delay.
@@ -2737,27 +3801,14 @@ void DeRestPlugin::stopReadTimer()
     m_readAttributesTimer->stop();
 }
 
-/*! Checks if attributes of any nodes shall be queried.
+/*! Processes the reads of the node which is due first.
  */
 void DeRestPlugin::checkReadTimerFired()
 {
-    std::vector<LightNode>::iterator i = d->nodes.begin();
-    std::vector<LightNode>::iterator end = d->nodes.end();
-
-    stopReadTimer();
-
-    for (; i != end; ++i)
+    if (d->processReadQueue())
     {
-        if (d->processReadAttributes(&(*i)))
-        {
-            // read next later
-            startReadTimer(ReadAttributesDelay);
-            d->processTasks();
-            return;
-        }
+        d->processTasks();
     }
-
-    startReadTimer(ReadAttributesDelay);
 }
 
 /*! Handler called before the application will be closed.
@@ -2876,35 +3927,23 @@ QDialog *DeRestPlugin::createDialog()
  */
 bool DeRestPlugin::isHttpTarget(const QHttpRequestHeader &hdr)
 {
-    if (hdr.path().startsWith("/api/config"))
+    if (hdr.path().startsWith("/api"))
     {
-        return true;
-    }
-    else if (hdr.path().startsWith("/api"))
-    {
-        QString path = hdr.path();
-        int quest = path.indexOf('?');
+        RestPath path;
 
-        if (quest > 0)
+        if (!path.parse(hdr.path().toLatin1()))
         {
-            path = path.mid(0, quest);
+            return false;
         }
 
-        QStringList ls = path.split("/", QString::SkipEmptyParts);
-
-        if (ls.size() > 2)
+        // /api, /api/config and /api/287398279837
+        if ((path.count() <= 2) || path.isSegment(1, "config", 6))
         {
-            if ((ls[2] == "lights") ||
-                (ls[2] == "groups") ||
-                (ls[2] == "config") ||
-                (ls[2] == "schedules") ||
-                (ls[2] == "touchlink") ||
-                (hdr.path().at(4) != '/') /* Bug in some clients */)
-            {
-                return true;
-            }
+            return true;
         }
-        else // /api, /api/config and /api/287398279837
+
+        if (d->router.isResource(path, 2) ||
+            (hdr.path().size() > 4 && hdr.path().at(4) != '/') /* Bug in some clients */)
         {
             return true;
         }
@@ -2928,50 +3967,126 @@ bool DeRestPlugin::isHttpTarget(const QHttpRequestHeader &hdr)
  */
 int DeRestPlugin::handleHttpRequest(const QHttpRequestHeader &hdr, QTcpSocket *sock)
 {
-    QString content;
-    QTextStream stream(sock);
-    QHttpRequestHeader hdrmod(hdr);
+    connect(sock, SIGNAL(destroyed()),
+            d, SLOT(clientSocketDestroyed()), Qt::UniqueConnection);
+
+    return serveHttpRequests(hdr, sock, QByteArray());
+}
 
-    stream.setCodec(QTextCodec::codecForName("UTF-8"));
+/*! Continues a request whose body was incomplete when its header arrived.
+ */
+void DeRestPlugin::clientReadyRead()
+{
+    QTcpSocket *sock = qobject_cast<QTcpSocket*>(sender());
+    QHttpRequestHeader hdr;
+    QByteArray content;
 
-    if (m_state == StateOff)
+    if (!sock || !d->takePendingRequest(sock, hdr, content))
     {
-        if (d->apsCtrl && (d->apsCtrl->networkState() == deCONZ::InNetwork))
+        return;
+    }
+
+    disconnect(sock, SIGNAL(readyRead()), this, SLOT(clientReadyRead()));
+    serveHttpRequests(hdr, sock, content);
+}
+
+/*! Answers a request and the requests which are pipelined after it.
+
+    Requests on persistent connections might be pipelined, these are
+    read from the socket and answered in order after the first request.
+    A request whose body didn't fully arrive yet is continued
+    by clientReadyRead().
+    \param hdr - http request header
+    \param sock - the client socket
+    \param content - the body of the request received so far
+    \return 0 - on success
+           -1 - on error
+ */
+int DeRestPlugin::serveHttpRequests(const QHttpRequestHeader &hdr, QTcpSocket *sock, QByteArray content)
+{
+    QHttpRequestHeader pipelined;
+    const QHttpRequestHeader *current = &hdr;
+
+    for (;;)
+    {
+        int body = d->readHttpBody(*current, sock, content);
+
+        if (body == 0)
         {
-            m_state = StateIdle;
+            connect(sock, SIGNAL(readyRead()),
+                    this, SLOT(clientReadyRead()), Qt::UniqueConnection);
+            return 0;
+        }
+        else if (body < 0)
+        {
+            // the body can't be told apart from a following request
+            DBG_Printf(DBG_HTTP, "HTTP %s %s without Content-Length\n", qPrintable(current->method()), qPrintable(current->path()));
+            QByteArray rspData;
+            rspData.append("HTTP/1.1 ").append(HttpStatusLengthRequired).append("\r\n");
+            rspData.append("Content-Length: 0\r\n");
+            rspData.append("Connection: close\r\n");
+            rspData.append("\r\n");
+            sock->write(rspData);
+            sock->flush();
+            d->pushClientForClose(sock, HTTP_CLOSE_TIMEOUT);
+            return 0;
+        }
+
+        bool keepAlive = d->checkKeepAlive(*current, sock);
+        int ret = processHttpRequest(*current, sock, keepAlive, content);
+
+        if ((ret != 0) || !keepAlive || d->isEventListener(sock))
+        {
+            return ret; // an event stream occupies the connection until it is closed
+        }
+
+        int hdrLength = 0;
+        if (!d->peekPipelinedRequest(sock, pipelined, hdrLength) || !isHttpTarget(pipelined))
+        {
+            return ret;
         }
+
+        DBG_Printf(DBG_HTTP, "HTTP pipelined request %s %s\n", qPrintable(pipelined.method()), qPrintable(pipelined.path()));
+        sock->read(hdrLength); // consume header
+        current = &pipelined;
+        content.clear();
     }
 
-    QUrl url(hdrmod.path()); // get rid of query string
-    QString strpath = url.path();
+    return 0;
+}
 
-    if (hdrmod.path().startsWith("/api"))
+/*! Handles a single REST API request and sends the response.
+    \param hdr - http request header
+    \param sock - the client socket
+    \param keepAlive - true if the connection is kept open after the response
+    \param content - the complete body of the request
+    \return 0 - on success
+           -1 - on error
+ */
+int DeRestPlugin::processHttpRequest(const QHttpRequestHeader &hdr, QTcpSocket *sock, bool keepAlive, const QByteArray &content)
+{
+    if (m_state == StateOff)
     {
-        // some clients send /api123 instead of /api/123
-        // correct the path here
-        if (hdrmod.path().length() > 4 && hdrmod.path().at(4) != '/')
+        if (d->apsCtrl && (d->apsCtrl->networkState() == deCONZ::InNetwork))
         {
-            strpath.insert(4, '/');
+            m_state = StateIdle;
         }
     }
 
-    hdrmod.setRequest(hdrmod.method(), strpath);
-
-    DBG_Printf(DBG_HTTP, "HTTP API %s %s - %s\n", qPrintable(hdr.method()), qPrintable(hdrmod.path()), qPrintable(sock->peerAddress().toString()));
+    DBG_Printf(DBG_HTTP, "HTTP API %s %s - %s\n", qPrintable(hdr.method()), qPrintable(hdr.path()), qPrintable(sock->peerAddress().toString()));
 
     //qDebug() << hdr.toString();
 
-    if (!stream.atEnd())
+    if (!content.isEmpty())
     {
-        content = stream.readAll();
-        DBG_Printf(DBG_HTTP, "\t%s\n", qPrintable(content));
+        DBG_Printf(DBG_HTTP, "\t%s\n", content.constData());
     }
 
-    connect(sock, SIGNAL(destroyed()),
-            d, SLOT(clientSocketDestroyed()));
-
-    QStringList path = hdrmod.path().split("/", QString::SkipEmptyParts);
-    ApiRequest req(hdrmod, path, sock, content);
+    // the path is split once, query string and client quirks are handled by RestPath
+    RestPath restPath;
+    restPath.parse(hdr.path().toLatin1());
+    QStringList path = restPath.toStringList();
+    ApiRequest req(hdr, path, sock, content);
     ApiResponse rsp;
 
     rsp.httpStatus = HttpStatusNotFound;
@@ -2979,48 +4094,43 @@ int DeRestPlugin::handleHttpRequest(const QHttpRequestHeader &hdr, QTcpSocket *s
 
     int ret = REQ_NOT_HANDLED;
 
+    QByteArray connection;
+
+    if (keepAlive)
+    {
+        connection = QString("Connection: keep-alive\r\nKeep-Alive: timeout=%1\r\n").arg(d->gwHttpKeepAliveTimeout).toLatin1();
+    }
+    else
+    {
+        connection = "Connection: close\r\n";
+    }
+
     // general response to a OPTIONS HTTP method
     if (req.hdr.method() == "OPTIONS")
     {
-        stream << "HTTP/1.1 200 OK\r\n";
-        stream << "Cache-Control: no-store, no-cache, must-revalidate, post-check=0, pre-check=0\r\n";
-        stream << "Pragma: no-cache\r\n";
-        stream << "Connection: close\r\n";
-        stream << "Access-Control-Max-Age: 0\r\n";
-        stream << "Access-Control-Allow-Origin: *\r\n";
-        stream << "Access-Control-Allow-Credentials: true\r\n";
-        stream << "Access-Control-Allow-Methods: POST, GET, OPTIONS, PUT, DELETE\r\n";
-        stream << "Access-Control-Allow-Headers: Content-Type\r\n";
-        stream << "Content-type: text/html\r\n";
-        stream << "Content-Length: 0\r\n";
-        stream << "\r\n";
-        req.sock->flush();
+        QByteArray rspData;
+        rspData.append("HTTP/1.1 200 OK\r\n");
+        rspData.append("Cache-Control: no-store, no-cache, must-revalidate, post-check=0, pre-check=0\r\n");
+        rspData.append("Pragma: no-cache\r\n");
+        rspData.append(connection);
+        rspData.append("Access-Control-Max-Age: 0\r\n");
+        rspData.append("Access-Control-Allow-Origin: *\r\n");
+        rspData.append("Access-Control-Allow-Credentials: true\r\n");
+        rspData.append("Access-Control-Allow-Methods: POST, GET, OPTIONS, PUT, DELETE\r\n");
+        rspData.append("Access-Control-Allow-Headers: Content-Type\r\n");
+        rspData.append("Content-type: text/html\r\n");
+        rspData.append("Content-Length: 0\r\n");
+        rspData.append("\r\n");
+        sock->write(rspData);
+        sock->flush();
         return 0;
     }
 
-    if (path.size() > 2)
-    {
-        if (path[2] == "lights")
-        {
-            ret = d->handleLightsApi(req, rsp);
-        }
-        else if (path[2] == "groups")
-        {
-            ret = d->handleGroupsApi(req, rsp);
-        }
-        else if (path[2] == "schedules")
-        {
-            ret = d->handleSchedulesApi(req, rsp);
-        }
-        else if (path[2] == "touchlink")
-        {
-            ret = d->handleTouchlinkApi(req, rsp);
-        }
-    }
+    const RestRoute *route = d->router.match(hdr.method(), restPath);
 
-    if (ret == REQ_NOT_HANDLED)
+    if (route)
     {
-        ret = d->handleConfigurationApi(req, rsp);
+        ret = d->handleApiRequest(route, req, rsp);
     }
 
     if (ret == REQ_DONE)
@@ -3034,22 +4144,20 @@ int DeRestPlugin::handleHttpRequest(const QHttpRequestHeader &hdr, QTcpSocket *s
     }
     else if (hdr.path().startsWith("/description.xml") && (hdr.method() == "GET"))
     {
-        rsp.httpStatus = HttpStatusOk;
-        rsp.contentType = HttpContentHtml;
-        rsp.str = d->descriptionXml;
-
         if (d->descriptionXml.isEmpty())
         {
             return -1;
         }
-        stream << "HTTP/1.1 " << HttpStatusOk << "\r\n";
-        stream << "Content-Type: application/xml\r\n";
-        stream << "Content-Length:" << QString::number(d->descriptionXml.size()) << "\r\n";
-        stream << "Connection: close\r\n";
-        d->pushClientForClose(sock, 2);
-        stream << "\r\n";
-        stream << d->descriptionXml.constData();
-        stream.flush();
+
+        QByteArray rspData;
+        rspData.append("HTTP/1.1 ").append(HttpStatusOk).append("\r\n");
+        rspData.append("Content-Type: application/xml\r\n");
+        rspData.append("Content-Length:").append(QByteArray::number(d->descriptionXml.size())).append("\r\n");
+        rspData.append(connection);
+        rspData.append("\r\n");
+        rspData.append(d->descriptionXml);
+        sock->write(rspData);
+        sock->flush();
         return 0;
 
     }
@@ -3058,42 +4166,35 @@ int DeRestPlugin::handleHttpRequest(const QHttpRequestHeader &hdr, QTcpSocket *s
         DBG_Printf(DBG_HTTP, "%s unknown request: %s\n", Q_FUNC_INFO, qPrintable(hdr.path()));
     }
 
-    QString str;
+    QByteArray str;
 
-    if (!rsp.map.isEmpty())
+    if (!rsp.data.isEmpty())
+    {
+        rsp.contentType = HttpContentJson;
+        str = rsp.data;
+    }
+    else if (!rsp.map.isEmpty())
     {
         rsp.contentType = HttpContentJson;
-        str.append(Json::serialize(rsp.map));
+        str = Json::serialize(rsp.map);
     }
     else if (!rsp.list.isEmpty())
     {
         rsp.contentType = HttpContentJson;
-        str.append(Json::serialize(rsp.list));
+        str = Json::serialize(rsp.list);
     }
     else if (!rsp.str.isEmpty())
     {
         rsp.contentType = HttpContentJson;
-        str = rsp.str;
+        str = rsp.str.toUtf8();
     }
 
-    stream << "HTTP/1.1 " << rsp.httpStatus << "\r\n";
-    stream << "Content-Type: " << rsp.contentType << "\r\n";
-    stream << "Content-Length:" << QString::number(str.toUtf8().size()) << "\r\n";
-
-    bool keepAlive = false;
-    if (hdr.hasKey("Connection"))
-    {
-        if (hdr.value("Connection").toLower() == "keep-alive")
-        {
-            keepAlive = true;
-            d->pushClientForClose(sock, 3);
-        }
-    }
-    if (!keepAlive)
-    {
-        stream << "Connection: close\r\n";
-        d->pushClientForClose(sock, 2);
-    }
+    QByteArray rspData;
+    rspData.reserve(256 + str.size());
+    rspData.append("HTTP/1.1 ").append(rsp.httpStatus).append("\r\n");
+    rspData.append("Content-Type: ").append(rsp.contentType).append("\r\n");
+    rspData.append("Content-Length:").append(QByteArray::number(str.size())).append("\r\n");
+    rspData.append(connection);
 
     if (!rsp.hdrFields.empty())
     {
@@ -3102,25 +4203,27 @@ int DeRestPlugin::handleHttpRequest(const QHttpRequestHeader &hdr, QTcpSocket *s
 
         for (; i != end; ++i)
         {
-            stream << i->first << ": " <<  i->second << "\r\n";
+            rspData.append(i->first.toUtf8()).append(": ").append(i->second.toUtf8()).append("\r\n");
         }
     }
 
     if (!rsp.etag.isEmpty())
     {
-        stream << "ETag:" << rsp.etag  << "\r\n";
+        rspData.append("ETag:").append(rsp.etag.toUtf8()).append("\r\n");
     }
-    stream << "\r\n";
+    rspData.append("\r\n");
 
     if (!str.isEmpty())
     {
-        stream << str;
+        rspData.append(str);
     }
 
-    stream.flush();
+    sock->write(rspData);
+    sock->flush();
+
     if (!str.isEmpty())
     {
-        DBG_Printf(DBG_HTTP, "%s\n", qPrintable(str));
+        DBG_Printf(DBG_HTTP, "%s\n", str.constData());
     }
 
     return 0;
@@ -3131,10 +4234,11 @@ int DeRestPlugin::handleHttpRequest(const QHttpRequestHeader &hdr, QTcpSocket *s
  */
 void DeRestPlugin::clientGone(QTcpSocket *sock)
 {
-    d->eventListeners.remove(sock);
+    d->removeEventListener(sock);
 }
 
 /*! Checks if some tcp connections could be closed.
+    Persistent connections are closed after being idle for gwHttpKeepAliveTimeout seconds.
  */
 void DeRestPluginPrivate::openClientTimerFired()
 {
@@ -3143,6 +4247,11 @@ void DeRestPluginPrivate::openClientTimerFired()
 
     for ( ; i != end; ++i)
     {
+        if (i->closeTimeout < 0)
+        {
+            continue; // already closed or kept open (event stream)
+        }
+
         i->closeTimeout--;
         if (i->closeTimeout == 0)
         {
@@ -3165,7 +4274,6 @@ void DeRestPluginPrivate::openClientTimerFired()
                 }
 
                 sock->deleteLater();
-                return;
             }
         }
     }
@@ -3178,6 +4286,8 @@ void DeRestPluginPrivate::clientSocketDestroyed()
     QObject *obj = sender();
     QTcpSocket *sock = static_cast<QTcpSocket *>(obj);
 
+    removeEventListener(sock);
+
     std::list<TcpClient>::iterator i = openClients.begin();
     std::list<TcpClient>::iterator end = openClients.end();
 
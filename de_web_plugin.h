@@ -63,8 +63,11 @@ public Q_SLOTS:
     void stopReadTimer();
     void checkReadTimerFired();
     void appAboutToQuit();
+    void clientReadyRead();
 
 private:
+    int serveHttpRequests(const QHttpRequestHeader &hdr, QTcpSocket *sock, QByteArray content);
+    int processHttpRequest(const QHttpRequestHeader &hdr, QTcpSocket *sock, bool keepAlive, const QByteArray &content);
     void taskHandler(Event event);
     void handleStateOff(Event event);
     void handleStateIdle(Event event);
@@ -14,8 +14,13 @@
 #include <QObject>
 #include <QTime>
 #include <QTimer>
+#include <QHash>
+#include <QHttpRequestHeader>
 #include <QElapsedTimer>
 #include <stdint.h>
+#include <deque>
+#include <queue>
+#include <functional>
 #include "sqlite3.h"
 #include <deconz.h>
 #include "rest_node_base.h"
@@ -23,6 +28,7 @@
 #include "group.h"
 #include "group_info.h"
 #include "scene.h"
+#include "rest_router.h"
 
 /*! JSON generic error message codes */
 #define ERR_UNAUTHORIZED_USER          1
@@ -44,12 +50,30 @@
 #define ERR_BRIDGE_GROUP_TABLE_FULL    301
 #define ERR_DEVICE_GROUP_TABLE_FULL    302
 
-#define IDLE_LIMIT 30
-#define IDLE_READ_LIMIT 120
+#define IDLE_READ_LIMIT 120 // seconds until the state of a light which doesn't report is refreshed
 #define IDLE_USER_LIMIT 60
+#define RADIO_FRAMES_PER_SECOND 20 // unicast frames per second the gateway can send
+#define POLL_SHARE_DEFAULT 10 // percent of RADIO_FRAMES_PER_SECOND spent on polling
+#define POLL_MAX_CREDIT 10 // frames the polling budget can save up
+#define POLL_BUSY_QUEUED 8 // queued tasks above which polling pauses
+#define POLL_REPORTING_AGE 1800 // seconds until groups and scenes of a reporting light are refreshed
+#define SCENE_DISCOVERY_SAMPLES 2 // group members queried for the scene membership of a group
+#define SCENE_DISCOVERY_TIMEOUT 60 // seconds to wait for the responses of sampled members
+#define SCENE_DISCOVERY_MAX_AGE 1800 // seconds the sampled scene membership of a group is trusted
+#define REPORT_MIN_INTERVAL 1 // seconds min. interval between two attribute reports
+#define REPORT_MAX_INTERVAL 300 // seconds max. interval, a reporting light sends at least this often
+#define REPORT_TIMEOUT (2 * REPORT_MAX_INTERVAL + 60) // seconds without report until a light is polled again
+
+#define HTTP_KEEP_ALIVE_TIMEOUT 10 // seconds an idle persistent connection is kept open
+#define HTTP_KEEP_ALIVE_MAX 100 // requests served on one connection before it gets closed
+#define HTTP_CLOSE_TIMEOUT 2 // seconds until a connection marked as close is closed
+#define HTTP_BODY_TIMEOUT 10 // seconds to wait for the rest of a request body
+#define MAX_HTTP_HEADER_SIZE 8192
 
 #define MAX_UNLOCK_GATEWAY_TIME 600
 #define PERMIT_JOIN_SEND_INTERVAL (1000 * 160)
+#define HOUSEKEEPING_TICK 1000 // ms period of the once per second housekeeping jobs
+#define GROUP_TASK_PERIOD 250 // ms between two runs of processGroupTasks()
 
 #define DE_PROFILE_ID           0xDE00
 
@@ -83,6 +107,10 @@
 #define LEVEL_CLUSTER_ID 0x0008
 #define COLOR_CLUSTER_ID 0x0300
 
+#ifndef ZDP_BIND_REQ_CLID
+#define ZDP_BIND_REQ_CLID 0x0021
+#endif
+
 // manufacturer codes
 #define VENDOR_DDEL     0x1014
 #define VENDOR_PHILIPS  0x100B
@@ -92,6 +120,22 @@
 #define MAX_GROUP_SEND_DELAY 5000 // ms between to requests to the same group
 #define GROUP_SEND_DELAY 500 // default ms between to requests to the same group
 
+#define TASK_MAX_QUEUED 256 // max. queued tasks of all destinations
+#define TASK_MAX_PER_DESTINATION 16 // max. queued tasks of one destination
+#define TASK_MIN_RUNNING 1 // lower bound of the in-flight window
+#define TASK_INITIAL_RUNNING 5 // in-flight window until confirms are measured
+#define TASK_MAX_RUNNING 16 // upper bound of the in-flight window
+#define TASK_RTT_TOLERANCE 100 // ms the smoothed confirm latency may exceed twice its minimum
+#define TASK_RTT_MIN_PERIOD 60000 // ms after which the minimum confirm latency is measured again
+#define TASK_CONFIRM_TIMEOUT 10000 // ms until a running task without APSDE-DATA.confirm expires
+#define TASK_RETRY_DELAY 100 // ms to wait after a rejected APSDE-DATA.request
+#define TASK_POOL_SIZE (TASK_MAX_QUEUED + TASK_MAX_RUNNING) // preallocated tasks
+
+#define NETWORK_INFO_REFRESH_INTERVAL (60 * 1000) // ms to keep cached network interface info
+#define CHANGE_LOG_MAX_SIZE 1024 // max. entries kept for GET /api/<apikey>/changes
+#define EVENT_MAX_PENDING_BYTES (256 * 1024) // event stream clients with more unsent data are dropped
+#define BATCH_MAX_OPERATIONS 128 // max. operations of PUT /api/<apikey>/batch
+
 // string lengths
 #define MAX_GROUP_NAME_LENGTH 32
 #define MAX_SCENE_NAME_LENGTH 32
@@ -127,6 +171,7 @@
 #define DB_SCHEDULES   0x00000020
 
 #define DB_LONG_SAVE_DELAY  (5 * 60 * 1000) // 5 minutes
+#define AUTH_LAST_USE_INTERVAL 60 // seconds granularity of ApiAuth::lastUseDate
 #define DB_SHORT_SAVE_DELAY (5 *  1 * 1000) // 5 seconds
 
 // internet discovery
@@ -141,6 +186,7 @@ extern const char *HttpStatusForbidden;
 extern const char *HttpStatusNotFound;
 extern const char *HttpStatusNotImplemented;
 extern const char *HttpStatusServiceUnavailable;
+extern const char *HttpStatusLengthRequired;
 extern const char *HttpContentHtml;
 extern const char *HttpContentCss;
 extern const char *HttpContentJson;
@@ -148,6 +194,7 @@ extern const char *HttpContentJS;
 extern const char *HttpContentPNG;
 extern const char *HttpContentJPG;
 extern const char *HttpContentSVG;
+extern const char *HttpContentEventStream;
 
 // Forward declarations
 class QUdpSocket;
@@ -197,7 +244,9 @@ enum TaskType
     TaskCallScene,
     TaskRemoveScene,
     TaskAddToGroup,
-    TaskRemoveFromGroup
+    TaskRemoveFromGroup,
+    TaskBind,
+    TaskConfigureReporting
 };
 
 struct TaskItem
@@ -237,6 +286,129 @@ struct TaskItem
     deCONZ::ZclCluster *cluster;
 };
 
+/*! \class TaskDestination
+
+    Queued tasks of one destination address, linked by pool index.
+ */
+class TaskDestination
+{
+public:
+    TaskDestination();
+
+    int head; // pool index of the first queued task, -1 if empty
+    int tail; // pool index of the last queued task, -1 if empty
+    int count; // number of queued tasks
+    bool busy; // a task to this destination is running
+    bool ready; // listed in the ready list of the TaskQueue
+    bool parked; // waits for a deadline before it gets ready again
+};
+
+/*! \class RunningTask
+
+    A task which waits for its APSDE-DATA.confirm.
+ */
+class RunningTask
+{
+public:
+    int slot; // pool index of the task, -1 if no task runs with this request id
+    qint64 sendTime; // ms of the TaskQueue clock
+};
+
+// light attributes which are set by a task
+#define TASK_ATTR_ON_OFF  0x01
+#define TASK_ATTR_LEVEL   0x02
+#define TASK_ATTR_HUE     0x04
+#define TASK_ATTR_SAT     0x08
+#define TASK_ATTR_COLOR   (TASK_ATTR_HUE | TASK_ATTR_SAT) // hue and saturation or xy
+
+/*! \class TaskQueue
+
+    Queues tasks per destination address.
+
+    Destinations which have queued tasks but no running task are kept in a
+    ready list, so enqueue, dedup and dispatch don't need to scan other
+    destinations. Only one task per destination is running at a time.
+
+    Tasks are stored in a preallocated pool. Queues and running tasks only
+    refer to pool slots, so a task is copied once when added and isn't
+    copied again when it starts or finishes.
+ */
+class TaskQueue
+{
+public:
+    TaskQueue();
+    bool add(const TaskItem &task);
+    bool popReady(quint64 *dst);
+    void pushReady(quint64 dst);
+    void park(quint64 dst, int delay);
+    void resumeParked();
+    qint64 nextWakeup();
+    TaskItem *front(quint64 dst);
+    void queuedTasks(quint64 dst, std::vector<TaskItem*> &tasks);
+    void readyDestinations(std::vector<quint64> &dsts) const;
+    void dropFront(quint64 dst);
+    void startFront(quint64 dst);
+    bool confirm(uint8_t id, bool success);
+    int expire();
+    void clear();
+    bool isEmpty() const;
+    int queuedCount() const;
+    int runningCount() const;
+    int readyCount() const;
+    int freeCount(quint64 dst) const;
+    int expiredCount() const;
+    int window() const;
+    qint64 roundTripTime() const;
+    static quint64 destinationKey(const deCONZ::ApsDataRequest &req);
+    static uint taskAttributes(const TaskItem &task);
+
+private:
+    void release(quint64 dst);
+    int popFront(QHash<quint64, TaskDestination>::iterator d);
+    void freeSlot(int slot);
+    void finish(uint8_t id);
+    void increaseWindow();
+    void decreaseWindow(const char *reason);
+
+    std::vector<TaskItem> m_pool; // preallocated storage of queued and running tasks
+    std::vector<int> m_next; // pool index of the next task in the same queue, -1 at the end
+    std::vector<int> m_free; // unused pool indices
+    QHash<quint64, TaskDestination> m_destinations;
+    std::deque<quint64> m_ready; // idle destinations with queued tasks
+    std::priority_queue<QPair<qint64, quint64>, std::vector<QPair<qint64, quint64> >, std::greater<QPair<qint64, quint64> > > m_parked; // deadline and key of parked destinations, earliest first
+    RunningTask m_running[256]; // tasks waiting for APSDE-DATA.confirm by APS request id
+    int m_runningCount;
+    std::deque<QPair<uint8_t, qint64> > m_deadlines; // APS request id and send time in send order
+    QElapsedTimer m_clock;
+    int m_queued;
+    int m_expired; // running tasks which never got a confirm
+    double m_window; // max. running tasks (AIMD)
+    qint64 m_srtt; // smoothed confirm latency in ms, 0 if unknown
+    qint64 m_minRtt; // lowest confirm latency in ms of the current period, 0 if unknown
+    qint64 m_prevMinRtt; // lowest confirm latency in ms of the previous period, 0 if unknown
+    qint64 m_minRttStart; // ms when the current period started
+    qint64 m_lastDecrease; // ms of the last window decrease
+};
+
+/*! \class ResourceChange
+
+    Entry of the change log, records that a resource got a new version.
+ */
+class ResourceChange
+{
+public:
+    enum Type
+    {
+        TypeConfig,
+        TypeLight,
+        TypeGroup
+    };
+
+    quint64 version;
+    Type type;
+    QString id; // light or group id, empty for config
+};
+
 /*! \class ApiAuth
 
     Helper to combine serval authentification parameters.
@@ -251,6 +423,7 @@ public:
     QDateTime createDate;
     QDateTime lastUseDate;
     QString useragent;
+    bool needSaveDatabase; // true if the entry was changed since last save
 };
 
 enum ApiVersion
@@ -266,14 +439,17 @@ enum ApiVersion
 class ApiRequest
 {
 public:
-    ApiRequest(const QHttpRequestHeader &h, const QStringList &p, QTcpSocket *s, const QString &c);
+    ApiRequest(const QHttpRequestHeader &h, const QStringList &p, QTcpSocket *s, const QByteArray &c);
     QString apikey() const;
     ApiVersion apiVersion() const { return version; }
+    QVariant json(bool &ok) const;
 
     const QHttpRequestHeader &hdr;
     const QStringList &path;
     QTcpSocket *sock;
-    QString content;
+    QByteArray content; // UTF-8 encoded body
+    QVariant body; // already parsed body, used instead of content if valid
+    bool batch; // part of a batch request, the tasks are processed after the last operation
     ApiVersion version;
 };
 
@@ -290,13 +466,61 @@ struct ApiResponse
     QVariantMap map; // json content
     QVariantList list; // json content
     QString str; // json string
+    QByteArray data; // pre-serialized json content (UTF-8)
 };
 
 class TcpClient
 {
 public:
-    int closeTimeout; // close socket in n seconds
+    int closeTimeout; // close socket in n seconds, < 0 never
+    int requests; // number of requests served on this connection
+    QTcpSocket *sock;
+    bool pending; // a request waits for the rest of its body
+    QHttpRequestHeader pendingHdr; // header of the pending request
+    QByteArray pendingBody; // body of the pending request received so far
+};
+
+/*! \class EventListener
+
+    Client of the server-sent events stream GET /api/<apikey>/events.
+ */
+class EventListener
+{
+public:
     QTcpSocket *sock;
+    ApiVersion apiVersion;
+};
+
+/*! Entry of the read queue, a light whose reads are due at a given time.
+    Lights which are due at the same time are processed in the order they
+    were queued.
+ */
+struct ReadDue
+{
+    qint64 due; // ms of starttimeRef
+    quint32 order; // queue order
+    uint index; // index in nodes
+
+    bool operator>(const ReadDue &other) const
+    {
+        if (due != other.due)
+        {
+            return due > other.due;
+        }
+        return order > other.order;
+    }
+};
+
+/*! Jobs of the housekeeping scheduler.
+ */
+enum HousekeepingJob
+{
+    JobGroupTasks,  //!< processGroupTasks()
+    JobOpenClients, //!< openClientTimerFired()
+    JobPermitJoin,  //!< permitJoinTimerFired()
+    JobOtau,        //!< otauTimerFired()
+    JobSchedules,   //!< scheduleTimerFired()
+    JobCount
 };
 
 /*! \class DeWebPluginPrivate
@@ -311,16 +535,25 @@ public:
     DeRestPluginPrivate(QObject *parent = 0);
     ~DeRestPluginPrivate();
 
+    // REST API routing
+    void initRestRoutes();
+    int handleApiRequest(const RestRoute *route, const ApiRequest &req, ApiResponse &rsp);
+
     // REST API authentification
     void initAuthentification();
     bool allowedToCreateApikey(const ApiRequest &req);
     bool checkApikeyAuthentification(const ApiRequest &req, ApiResponse &rsp);
+    ApiAuth *getApiAuthForKey(const QString &apikey);
+    void addApiAuth(const ApiAuth &auth);
     QString encryptString(const QString &str);
 
     // REST API configuration
-    int handleConfigurationApi(const ApiRequest &req, ApiResponse &rsp);
     int createUser(const ApiRequest &req, ApiResponse &rsp);
     int getFullState(const ApiRequest &req, ApiResponse &rsp);
+    const QByteArray &fullStateSnapshot(ApiVersion apiVersion);
+    void updateFullState(ApiVersion apiVersion);
+    int getChanges(const ApiRequest &req, ApiResponse &rsp);
+    void changesToJson(QByteArray &data, quint64 since, ApiVersion apiVersion);
     int getConfig(const ApiRequest &req, ApiResponse &rsp);
     int modifyConfig(const ApiRequest &req, ApiResponse &rsp);
     int updateSoftware(const ApiRequest &req, ApiResponse &rsp);
@@ -329,9 +562,21 @@ public:
     int deletePassword(const ApiRequest &req, ApiResponse &rsp);
 
     void configToMap(QVariantMap &map);
+    void updateNetworkInfo();
+
+    // REST API events
+    int getEvents(const ApiRequest &req, ApiResponse &rsp);
+    void appendEvent(QByteArray &data, quint64 since, ApiVersion apiVersion);
+    void removeEventListener(QTcpSocket *sock);
+    bool isEventListener(QTcpSocket *sock) const;
+
+    // REST API batch
+    int handleBatch(const ApiRequest &req, ApiResponse &rsp);
+
+    // REST API polling
+    int getPollingState(const ApiRequest &req, ApiResponse &rsp);
 
     // REST API lights
-    int handleLightsApi(ApiRequest &req, ApiResponse &rsp);
     int getAllLights(const ApiRequest &req, ApiResponse &rsp);
     int searchLights(const ApiRequest &req, ApiResponse &rsp);
     int getNewLights(const ApiRequest &req, ApiResponse &rsp);
@@ -339,10 +584,9 @@ public:
     int setLightState(const ApiRequest &req, ApiResponse &rsp);
     int renameLight(const ApiRequest &req, ApiResponse &rsp);
 
-    bool lightToMap(const ApiRequest &req, const LightNode *webNode, QVariantMap &map);
+    const QByteArray &lightToJson(ApiVersion apiVersion, LightNode *lightNode);
 
     // REST API groups
-    int handleGroupsApi(ApiRequest &req, ApiResponse &rsp);
     int getAllGroups(const ApiRequest &req, ApiResponse &rsp);
     int createGroup(const ApiRequest &req, ApiResponse &rsp);
     int getGroupAttributes(const ApiRequest &req, ApiResponse &rsp);
@@ -359,11 +603,10 @@ public:
     int recallScene(const ApiRequest &req, ApiResponse &rsp);
     int deleteScene(const ApiRequest &req, ApiResponse &rsp);
 
-    bool groupToMap(const Group *group, QVariantMap &map);
+    const QByteArray &groupToJson(Group *group);
 
     // REST API schedules
     void initSchedules();
-    int handleSchedulesApi(ApiRequest &req, ApiResponse &rsp);
     int getAllSchedules(const ApiRequest &req, ApiResponse &rsp);
     int createSchedule(const ApiRequest &req, ApiResponse &rsp);
     int getScheduleAttributes(const ApiRequest &req, ApiResponse &rsp);
@@ -372,11 +615,10 @@ public:
 
     // REST API touchlink
     void initTouchlinkApi();
-    int handleTouchlinkApi(ApiRequest &req, ApiResponse &rsp);
-    int touchlinkScan(ApiRequest &req, ApiResponse &rsp);
-    int getTouchlinkScanResults(ApiRequest &req, ApiResponse &rsp);
-    int identifyLight(ApiRequest &req, ApiResponse &rsp);
-    int resetLight(ApiRequest &req, ApiResponse &rsp);
+    int touchlinkScan(const ApiRequest &req, ApiResponse &rsp);
+    int getTouchlinkScanResults(const ApiRequest &req, ApiResponse &rsp);
+    int identifyLight(const ApiRequest &req, ApiResponse &rsp);
+    int resetLight(const ApiRequest &req, ApiResponse &rsp);
 
     // REST API common
     QVariantMap errorToMap(int id, const QString &ressource, const QString &description);
@@ -396,6 +638,19 @@ public:
     void otauSendNotify(LightNode *node);
     bool isOtauBusy();
 
+    // Housekeeping
+    void initHousekeeping();
+    void scheduleJob(HousekeepingJob job, int delay);
+    void startHousekeepingTimer();
+
+    // Polling
+    void initPolling();
+    void pollLights();
+    bool isReporting(const LightNode *lightNode) const;
+    int lightStaleness(const LightNode *lightNode) const;
+    int pollPriority(const LightNode *lightNode) const;
+    int pollCost(const LightNode *lightNode) const;
+
 public Q_SLOTS:
     void announceUpnp();
     void upnpReadyRead();
@@ -415,7 +670,9 @@ public Q_SLOTS:
     void updateFirmwareTimerFired();
     void lockGatewayTimerFired();
     void openClientTimerFired();
+    void housekeepingTimerFired();
     void clientSocketDestroyed();
+    void pushEventsTimerFired();
     void queryFirmwareVersionTimerFired();
     void checkMinFirmwareVersionFile();
     void saveDatabaseTimerFired();
@@ -440,7 +697,12 @@ public:
     void checkRfConnectState();
     bool isInNetwork();
     void generateGatewayUuid();
-    void updateEtag(QString &etag);
+    quint64 nextVersion();
+    static QString etagForVersion(quint64 version);
+    void updateLightEtag(LightNode *lightNode);
+    void updateGroupEtag(Group *group);
+    void updateConfigEtag();
+    void logChange(ResourceChange::Type type, const QString &id, quint64 version);
     qint64 getUptime();
     LightNode *addNode(const deCONZ::Node *node);
     LightNode *nodeZombieStateChanged(const deCONZ::Node *node);
@@ -456,26 +718,36 @@ public:
     deCONZ::ZclCluster *getInCluster(deCONZ::Node *node, uint8_t endpoint, uint16_t clusterId);
     uint8_t getSrcEndpoint(LightNode *lightNode, const deCONZ::ApsDataRequest &req);
     bool processReadAttributes(LightNode *lightNode);
+    void scheduleRead(LightNode *lightNode, int delay);
+    bool processReadQueue();
+    void startReadQueueTimer();
     bool readAttributes(LightNode *lightNode, const deCONZ::SimpleDescriptor *sd, uint16_t clusterId, const std::vector<uint16_t> &attributes);
     bool readGroupMembership(LightNode *lightNode, const std::vector<uint16_t> &groups);
+    bool configureReporting(LightNode *lightNode, uint16_t clusterId);
     void foundGroupMembership(LightNode *lightNode, uint16_t groupId);
     void foundGroup(uint16_t groupId);
     bool isLightNodeInGroup(LightNode *lightNode, uint16_t groupId);
     void readAllInGroup(Group *group);
     void setAttributeOnOffGroup(Group *group, uint8_t onOff);
     bool readSceneMembership(LightNode *lightNode, Group *group);
+    void checkSceneSample(Group *group, LightNode *lightNode, std::vector<uint8_t> &scenes);
     void foundScene(LightNode *lightNode, Group *group, uint8_t sceneId);
     void setSceneName(Group *group, uint8_t sceneId, const QString &name);
     bool storeScene(Group *group, uint8_t sceneId);
     bool removeScene(Group *group, uint8_t sceneId);
     bool callScene(Group *group, uint8_t sceneId);
 
-    bool pushState(QString json, QTcpSocket *sock);
-
-    void pushClientForClose(QTcpSocket *sock, int closeTimeout);
+    TcpClient *pushClientForClose(QTcpSocket *sock, int closeTimeout);
+    bool checkKeepAlive(const QHttpRequestHeader &hdr, QTcpSocket *sock);
+    bool peekPipelinedRequest(QTcpSocket *sock, QHttpRequestHeader &hdr, int &hdrLength);
+    int readHttpBody(const QHttpRequestHeader &hdr, QTcpSocket *sock, QByteArray &content);
+    bool takePendingRequest(QTcpSocket *sock, QHttpRequestHeader &hdr, QByteArray &content);
 
     // Task interface
     bool addTask(const TaskItem &task);
+    void startTaskTimer();
+    void promoteGroupcasts();
+    void updateGroupMembers();
     bool addTaskSetOnOff(TaskItem &task, bool on);
     bool addTaskSetBrightness(TaskItem &task, uint8_t bri, bool withOnOff);
     bool addTaskSetEnhancedHue(TaskItem &task, uint16_t hue);
@@ -490,9 +762,8 @@ public:
     bool obtainTaskCluster(TaskItem &task, const deCONZ::ApsDataIndication &ind);
     void handleGroupClusterIndication(TaskItem &task, const deCONZ::ApsDataIndication &ind, deCONZ::ZclFrame &zclFrame);
     void handleSceneClusterIndication(TaskItem &task, const deCONZ::ApsDataIndication &ind, deCONZ::ZclFrame &zclFrame);
+    void handleZclAttributeReportIndication(const deCONZ::ApsDataIndication &ind, deCONZ::ZclFrame &zclFrame);
     void handleDeviceAnnceIndication(const deCONZ::ApsDataIndication &ind);
-    void broadCastNodeUpdate(LightNode *webNode);
-    void markForPushUpdate(LightNode *lightNode);
     void taskToLocalData(const TaskItem &task);
 
     // Modify node attributes
@@ -523,8 +794,12 @@ public:
     std::vector<int> lightIds;
     QTimer *databaseTimer;
 
+    // REST API routes
+    RestRouter router;
+
     // authentification
     std::vector<ApiAuth> apiAuths;
+    QHash<QString, int> apiAuthIndex; // apikey -> index in apiAuths
     QString gwAdminUserName;
     QString gwAdminPasswordHash;
 
@@ -546,8 +821,31 @@ public:
     bool gwFirmwareNeedUpdate;
     QString gwUpdateChannel;
     int gwGroupSendDelay;
+    int gwHttpKeepAliveTimeout; // seconds, 0 disables persistent connections
+    int gwHttpKeepAliveMax; // max. requests per connection
     QVariantMap gwConfig;
     QString gwConfigEtag;
+    quint64 gwConfigVersion; // resource version of the last config change
+    quint64 gwGeneration; // latest resource version handed out by nextVersion()
+    QTime gwNetworkInfoTime; // last lookup of network interface info
+    QString gwNetmask;
+    QString gwMac;
+
+    // full state cache (GET /api/<apikey>)
+    QByteArray fullStateData; // serialized full state without leading utc field
+    quint64 fullStateGeneration; // gwGeneration when fullStateData was created
+    ApiVersion fullStateApiVersion;
+    uint8_t fullStatePermitJoin;
+    bool fullStateOtauBusy;
+
+    // change log (GET /api/<apikey>/changes)
+    std::deque<ResourceChange> changeLog; // ordered by version
+    quint64 changeLogTrimmed; // highest version which is no longer in the log
+
+    // event stream (GET /api/<apikey>/events)
+    std::list<EventListener> eventListeners;
+    quint64 eventGeneration; // generation up to which events were pushed
+    bool eventPushPending; // pushEventsTimerFired() is scheduled
 
     // upnp
     QByteArray descriptionXml;
@@ -556,12 +854,9 @@ public:
     QTimer *lockGatewayTimer;
 
     // permit join
-    // used by searchLights()
-    QTimer *permitJoinTimer;
     QTime permitJoinLastSendTime;
 
     // schedules
-    QTimer *scheduleTimer;
     std::vector<Schedule> schedules;
 
     // internet discovery
@@ -570,7 +865,6 @@ public:
     QNetworkReply *inetDiscoveryResponse;
 
     // otau
-    QTimer *otauTimer;
     int otauIdleTicks;
     int otauBusyTicks;
     uint otauNotifyIter; // iterator over nodes
@@ -631,24 +925,35 @@ public:
     deCONZ::ApsController *apsCtrl;
     uint groupTaskNodeIter; // Iterates through nodes array
     int idleTotalCounter; // sys timer
-    int idleLimit;
     int idleLastActivity; // delta in seconds
     std::vector<Group> groups;
     std::vector<LightNode> nodes;
-    std::list<LightNode*> broadCastUpdateNodes;
-    std::list<TaskItem> tasks;
-    std::list<TaskItem> runningTasks;
+    TaskQueue taskQueue;
+    bool groupcastCheck; // light state unicasts were added since the last promotion check
+    bool groupMembersDirty; // groupMembers must be rebuilt
+    QHash<uint16_t, std::vector<LightNode*> > groupMembers; // lights in each group with settled membership
     QTimer *taskTimer;
-    QTimer *groupTaskTimer;
     uint8_t zclSeq;
-    std::list<QTcpSocket*> eventListeners;
     QUdpSocket *udpSock;
     QUdpSocket *udpSockOut;
 
     // TCP connection watcher
-    QTimer *openClientTimer;
     std::list<TcpClient> openClients;
 
+    // housekeeping
+    QTimer *housekeepingTimer;
+    qint64 jobDeadline[JobCount]; // ms of starttimeRef, -1 if not scheduled
+    std::priority_queue<QPair<qint64, int>, std::vector<QPair<qint64, int> >, std::greater<QPair<qint64, int> > > jobQueue; // deadline and job, earliest first
+
+    // read queue
+    std::priority_queue<ReadDue, std::vector<ReadDue>, std::greater<ReadDue> > readQueue; // earliest due first
+    quint32 readOrder; // order of the next queued entry
+    qint64 readPaceTime; // ms of starttimeRef before which no further light is processed
+
+    // polling
+    int pollShare; // percent of RADIO_FRAMES_PER_SECOND
+    int pollCredit; // 1/100 frames which may be spent on polling
+
     // will be set at startup to calculate the uptime
     QElapsedTimer starttimeRef;
 
@@ -25,6 +25,9 @@ Group::Group() :
    level = 127;
    colorX = 0;
    colorY = 0;
+   version = 0;
+   sceneDiscovery = SceneDiscoveryNone;
+   sceneDiscoveryTime = 0;
 }
 
 /*! Returns the 16 bit group address.
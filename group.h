@@ -16,6 +16,7 @@
 #include <QTime>
 #include <vector>
 #include "scene.h"
+#include "json_cache.h"
 
 /*! \class Group
 
@@ -30,6 +31,14 @@ public:
         StateDeleted
     };
 
+    enum SceneDiscovery
+    {
+        SceneDiscoveryNone,     //!< scene membership not discovered yet
+        SceneDiscoverySampling, //!< waiting for the responses of sampled members
+        SceneDiscoveryDone,     //!< sampled members agree, valid for all members
+        SceneDiscoveryPerLight  //!< sampled members disagree, query each member
+    };
+
     Group();
     uint16_t address() const;
     void setAddress(uint16_t address);
@@ -48,8 +57,15 @@ public:
     uint16_t sat;
     uint16_t level;
     QString etag;
+    quint64 version; // resource version of the last change
+    JsonCache jsonCache; // serialized group attributes
     std::vector<Scene> scenes;
     QTime sendTime;
+    SceneDiscovery sceneDiscovery;
+    int sceneDiscoveryTime; // idleTotalCounter when sceneDiscovery was set
+    std::vector<quint64> sceneSampleLights; // ext. addresses of the members queried in this sampling round
+    std::vector<quint64> sceneSampleAnswers; // ext. addresses of the queried members which answered
+    std::vector<uint8_t> sceneSample; // sorted scene ids of the first response
 
 private:
     State m_state;
@@ -0,0 +1,161 @@
+/*
+ * Copyright (C) 2013 dresden elektronik ingenieurtechnik gmbh.
+ * All rights reserved.
+ *
+ * The software in this package is published under the terms of the BSD
+ * style license a copy of which has been included with this distribution in
+ * the LICENSE.txt file.
+ *
+ */
+
+#include "de_web_plugin.h"
+#include "de_web_plugin_private.h"
+
+/*! Inits the housekeeping scheduler.
+
+    Periodic jobs share one single-shot timer which is started for the
+    earliest job deadline. A job is only scheduled while it has something
+    to do, so an idle gateway doesn't wake up for nothing.
+ */
+void DeRestPluginPrivate::initHousekeeping()
+{
+    for (int i = 0; i < JobCount; i++)
+    {
+        jobDeadline[i] = -1;
+    }
+
+    housekeepingTimer = new QTimer(this);
+    housekeepingTimer->setSingleShot(true);
+    connect(housekeepingTimer, SIGNAL(timeout()),
+            this, SLOT(housekeepingTimerFired()));
+}
+
+/*! Schedules a housekeeping job.
+    A job which is already scheduled is only moved to an earlier deadline.
+    \param job - the job
+    \param delay - ms until the job shall run
+ */
+void DeRestPluginPrivate::scheduleJob(HousekeepingJob job, int delay)
+{
+    qint64 deadline = starttimeRef.elapsed() + delay;
+
+    if ((jobDeadline[job] >= 0) && (jobDeadline[job] <= deadline))
+    {
+        return;
+    }
+
+    // an outdated entry of the job stays in the queue and is skipped later
+    jobDeadline[job] = deadline;
+    jobQueue.push(qMakePair(deadline, (int)job));
+    startHousekeepingTimer();
+}
+
+/*! Runs all due housekeeping jobs.
+    Each job is scheduled again if there is more to do.
+ */
+void DeRestPluginPrivate::housekeepingTimerFired()
+{
+    qint64 now = starttimeRef.elapsed();
+
+    while (!jobQueue.empty() && (jobQueue.top().first <= now))
+    {
+        QPair<qint64, int> entry = jobQueue.top();
+        jobQueue.pop();
+
+        if (jobDeadline[entry.second] != entry.first)
+        {
+            continue; // rescheduled
+        }
+
+        jobDeadline[entry.second] = -1;
+
+        switch (entry.second)
+        {
+        case JobGroupTasks:
+            processGroupTasks();
+            if (!nodes.empty())
+            {
+                scheduleJob(JobGroupTasks, GROUP_TASK_PERIOD);
+            }
+            break;
+
+        case JobOpenClients:
+        {
+            openClientTimerFired();
+
+            std::list<TcpClient>::const_iterator i = openClients.begin();
+            std::list<TcpClient>::const_iterator end = openClients.end();
+
+            for (; i != end; ++i)
+            {
+                if (i->closeTimeout > 0)
+                {
+                    scheduleJob(JobOpenClients, HOUSEKEEPING_TICK);
+                    break;
+                }
+            }
+        }
+            break;
+
+        case JobPermitJoin:
+            permitJoinTimerFired();
+            if ((gwPermitJoinDuration > 0) && (gwPermitJoinDuration < 255))
+            {
+                scheduleJob(JobPermitJoin, HOUSEKEEPING_TICK); // count down
+            }
+            else if (permitJoinLastSendTime.isValid())
+            {
+                // next periodic resend
+                int delay = PERMIT_JOIN_SEND_INTERVAL - permitJoinLastSendTime.msecsTo(QTime::currentTime()) + 1;
+                scheduleJob(JobPermitJoin, qMax(delay, HOUSEKEEPING_TICK));
+            }
+            else
+            {
+                scheduleJob(JobPermitJoin, HOUSEKEEPING_TICK); // not sent yet
+            }
+            break;
+
+        case JobOtau:
+            otauTimerFired();
+            if (gwOtauActive)
+            {
+                scheduleJob(JobOtau, HOUSEKEEPING_TICK);
+            }
+            break;
+
+        case JobSchedules:
+            scheduleTimerFired();
+            if (!schedules.empty())
+            {
+                scheduleJob(JobSchedules, SCHEDULE_CHECK_PERIOD);
+            }
+            break;
+
+        default:
+            break;
+        }
+    }
+
+    startHousekeepingTimer();
+}
+
+/*! (Re)starts the housekeeping timer for the earliest job deadline.
+    The timer isn't running while no job is scheduled.
+ */
+void DeRestPluginPrivate::startHousekeepingTimer()
+{
+    // drop outdated entries so they don't cause extra wakeups
+    while (!jobQueue.empty() && (jobDeadline[jobQueue.top().second] != jobQueue.top().first))
+    {
+        jobQueue.pop();
+    }
+
+    if (jobQueue.empty())
+    {
+        housekeepingTimer->stop();
+        return;
+    }
+
+    qint64 delay = jobQueue.top().first - starttimeRef.elapsed();
+    housekeepingTimer->start((delay > 0) ? (int)delay : 0);
+}
@@ -2,36 +2,9 @@
  * \file json.cpp
  */
  
+#include <QStringList>
 #include "json.h"
 
-static QString sanitizeString(QString str)
-{
-    str.replace(QString("\\"), QString("\\\\"));
-    str.replace(QString("\""), QString("\\\""));
-    str.replace(QString("\b"), QString("\\b"));
-    str.replace(QString("\f"), QString("\\f"));
-    str.replace(QString("\n"), QString("\\n"));
-    str.replace(QString("\r"), QString("\\r"));
-    str.replace(QString("\t"), QString("\\t"));
-    str.prepend("\"");
-    str.append("\"");
-    return str;
-}
-
-static QByteArray join(const QList<QByteArray> &list, const QByteArray &sep)
-{
-	QByteArray res;
-	foreach(const QByteArray &i, list)
-	{
-		if(!res.isEmpty())
-		{
-			res += sep;
-		}
-		res += i;
-	}
-	return res;
-}
-
 /**
  * parse
  */
@@ -46,26 +19,22 @@ QVariant Json::parse(const QString &json)
  */
 QVariant Json::parse(const QString &json, bool &success)
 {
-	success = true;
+	return Json::parse(json.toUtf8(), success);
+}
 
-	//Return an empty QVariant if the JSON data is either null or empty
-	if(!json.isNull() || !json.isEmpty())
-	{
-		QString data = json;
-		//We'll start from index 0
-		int index = 0;
+/**
+ * parse
+ */
+QVariant Json::parse(const QByteArray &json, bool &success)
+{
+	success = true;
 
-		//Parse the first value
-		QVariant value = Json::parseValue(data, index, success);
+	//The data is parsed in place in a single pass
+	const char *p = json.constData();
+	const char *end = p + json.size();
 
-		//Return the parsed value
-		return value;
-	}
-	else
-	{
-		//Return the empty QVariant
-		return QVariant();
-	}
+	//Parse the first value, empty data will flag the failure
+	return Json::parseValue(p, end, success);
 }
 
 QByteArray Json::serialize(const QVariant &data)
@@ -77,78 +46,10 @@ QByteArray Json::serialize(const QVariant &data)
 QByteArray Json::serialize(const QVariant &data, bool &success)
 {
 	QByteArray str;
-	success = true;
+	JsonWriter writer(str);
 
-	if(!data.isValid()) // invalid or null?
-	{
-		str = "null";
-	}
-	else if((data.type() == QVariant::List) || (data.type() == QVariant::StringList)) // variant is a list?
-	{
-		QList<QByteArray> values;
-		const QVariantList list = data.toList();
-		foreach(const QVariant& v, list)
-		{
-			QByteArray serializedValue = serialize(v);
-			if(serializedValue.isNull())
-			{
-				success = false;
-				break;
-			}
-			values << serializedValue;
-		}
+	success = writer.value(data);
 
-		str = "[ " + join( values, ", " ) + " ]";
-	}
-	else if(data.type() == QVariant::Map) // variant is a map?
-	{
-		const QVariantMap vmap = data.toMap();
-		QMapIterator<QString, QVariant> it( vmap );
-		str = "{ ";
-		QList<QByteArray> pairs;
-		while(it.hasNext())
-		{
-			it.next();
-			QByteArray serializedValue = serialize(it.value());
-			if(serializedValue.isNull())
-			{
-				success = false;
-				break;
-			}
-			pairs << sanitizeString(it.key()).toUtf8() + " : " + serializedValue;
-		}
-		str += join(pairs, ", ");
-		str += " }";
-	}
-	else if((data.type() == QVariant::String) || (data.type() == QVariant::ByteArray)) // a string or a byte array?
-	{
-        str = sanitizeString(data.toString()).toAscii();
-	}
-	else if(data.type() == QVariant::Double) // double?
-	{
-		str = QByteArray::number(data.toDouble());
-	}
-	else if (data.type() == QVariant::Bool) // boolean value?
-	{
-		str = data.toBool() ? "true" : "false";
-	}
-	else if (data.type() == QVariant::ULongLong) // large unsigned number?
-	{
-		str = QByteArray::number(data.value<qulonglong>());
-	}
-	else if ( data.canConvert<qlonglong>() ) // any signed number?
-	{
-		str = QByteArray::number(data.value<qlonglong>());
-	}
-	else if (data.canConvert<QString>()) // can value be converted to string?
-	{
-		// this will catch QDate, QDateTime, QUrl, ...
-        str = sanitizeString(data.toString()).toAscii();
-	}
-	else
-	{
-		success = false;
-	}
 	if (success)
 	{
 		return str;
@@ -162,30 +63,30 @@ QByteArray Json::serialize(const QVariant &data, bool &success)
 /**
  * parseValue
  */
-QVariant Json::parseValue(const QString &json, int &index, bool &success)
+QVariant Json::parseValue(const char *&p, const char *end, bool &success)
 {
 	//Determine what kind of data we should parse by
 	//checking out the upcoming token
-	switch(Json::lookAhead(json, index))
+	switch(Json::lookAhead(p, end))
 	{
 		case JsonTokenString:
-			return Json::parseString(json, index, success);
+			return QVariant(Json::parseString(p, end, success));
 		case JsonTokenNumber:
-			return Json::parseNumber(json, index);
+			return Json::parseNumber(p, end);
 		case JsonTokenCurlyOpen:
-			return Json::parseObject(json, index, success);
+			return Json::parseObject(p, end, success);
 		case JsonTokenSquaredOpen:
-			return Json::parseArray(json, index, success);
+			return Json::parseArray(p, end, success);
 		case JsonTokenTrue:
-			Json::nextToken(json, index);
+			Json::nextToken(p, end);
 			return QVariant(true);
 		case JsonTokenFalse:
-			Json::nextToken(json, index);
+			Json::nextToken(p, end);
 			return QVariant(false);
 		case JsonTokenNull:
-			Json::nextToken(json, index);
+			Json::nextToken(p, end);
 			return QVariant();
-		case JsonTokenNone:
+		default:
 			break;
 	}
 
@@ -197,39 +98,38 @@ QVariant Json::parseValue(const QString &json, int &index, bool &success)
 /**
  * parseObject
  */
-QVariant Json::parseObject(const QString &json, int &index, bool &success)
+QVariant Json::parseObject(const char *&p, const char *end, bool &success)
 {
 	QVariantMap map;
 	int token;
 
-	//Get rid of the whitespace and increment index
-	Json::nextToken(json, index);
+	//Get rid of the whitespace and increment p
+	Json::nextToken(p, end);
 
 	//Loop through all of the key/value pairs of the object
-	bool done = false;
-	while(!done)
+	while(true)
 	{
 		//Get the upcoming token
-		token = Json::lookAhead(json, index);
+		token = Json::lookAhead(p, end);
 
 		if(token == JsonTokenNone)
 		{
-			 success = false;
-			 return QVariantMap();
+			success = false;
+			return QVariantMap();
 		}
 		else if(token == JsonTokenComma)
 		{
-			Json::nextToken(json, index);
+			Json::nextToken(p, end);
 		}
 		else if(token == JsonTokenCurlyClose)
 		{
-			Json::nextToken(json, index);
+			Json::nextToken(p, end);
 			return map;
 		}
 		else
 		{
 			//Parse the key/value pair's name
-			QString name = Json::parseString(json, index, success).toString();
+			QString name = Json::parseString(p, end, success);
 
 			if(!success)
 			{
@@ -237,7 +137,7 @@ QVariant Json::parseObject(const QString &json, int &index, bool &success)
 			}
 
 			//Get the next token
-			token = Json::nextToken(json, index);
+			token = Json::nextToken(p, end);
 
 			//If the next token is not a colon, flag the failure
 			//return an empty QVariant
@@ -248,7 +148,7 @@ QVariant Json::parseObject(const QString &json, int &index, bool &success)
 			}
 
 			//Parse the key/value pair's value
-			QVariant value = Json::parseValue(json, index, success);
+			QVariant value = Json::parseValue(p, end, success);
 
 			if(!success)
 			{
@@ -256,27 +156,23 @@ QVariant Json::parseObject(const QString &json, int &index, bool &success)
 			}
 
 			//Assign the value to the key in the map
-			map[name] = value;
+			map.insert(name, value);
 		}
 	}
-
-	//Return the map successfully
-	return QVariant(map);
 }
 
 /**
  * parseArray
  */
-QVariant Json::parseArray(const QString &json, int &index, bool &success)
+QVariant Json::parseArray(const char *&p, const char *end, bool &success)
 {
 	QVariantList list;
 
-	Json::nextToken(json, index);
+	Json::nextToken(p, end);
 
-	bool done = false;
-	while(!done)
+	while(true)
 	{
-		int token = Json::lookAhead(json, index);
+		int token = Json::lookAhead(p, end);
 
 		if(token == JsonTokenNone)
 		{
@@ -285,16 +181,16 @@ QVariant Json::parseArray(const QString &json, int &index, bool &success)
 		}
 		else if(token == JsonTokenComma)
 		{
-			Json::nextToken(json, index);
+			Json::nextToken(p, end);
 		}
 		else if(token == JsonTokenSquaredClose)
 		{
-			Json::nextToken(json, index);
+			Json::nextToken(p, end);
 			break;
 		}
 		else
 		{
-			QVariant value = Json::parseValue(json, index, success);
+			QVariant value = Json::parseValue(p, end, success);
 
 			if(!success)
 			{
@@ -308,183 +204,254 @@ QVariant Json::parseArray(const QString &json, int &index, bool &success)
 	return QVariant(list);
 }
 
+/**
+ * Appends the UTF-8 representation of a unicode code point
+ */
+static void appendUtf8(QByteArray &str, uint u)
+{
+	if (u < 0x80)
+	{
+		str.append((char)u);
+	}
+	else if (u < 0x800)
+	{
+		str.append((char)(0xC0 | (u >> 6)));
+		str.append((char)(0x80 | (u & 0x3F)));
+	}
+	else if (u < 0x10000)
+	{
+		str.append((char)(0xE0 | (u >> 12)));
+		str.append((char)(0x80 | ((u >> 6) & 0x3F)));
+		str.append((char)(0x80 | (u & 0x3F)));
+	}
+	else
+	{
+		str.append((char)(0xF0 | (u >> 18)));
+		str.append((char)(0x80 | ((u >> 12) & 0x3F)));
+		str.append((char)(0x80 | ((u >> 6) & 0x3F)));
+		str.append((char)(0x80 | (u & 0x3F)));
+	}
+}
+
+/**
+ * Parses 4 hex digits of an \u escape sequence
+ */
+static bool parseHex4(const char *p, const char *end, uint &u)
+{
+	if ((end - p) < 4)
+	{
+		return false;
+	}
+
+	u = 0;
+	for (int i = 0; i < 4; i++)
+	{
+		char c = p[i];
+		u <<= 4;
+
+		if      (c >= '0' && c <= '9') { u |= (c - '0'); }
+		else if (c >= 'a' && c <= 'f') { u |= (c - 'a' + 10); }
+		else if (c >= 'A' && c <= 'F') { u |= (c - 'A' + 10); }
+		else
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
 /**
  * parseString
  */
-QVariant Json::parseString(const QString &json, int &index, bool &success)
+QString Json::parseString(const char *&p, const char *end, bool &success)
 {
-	QString s;
-	QChar c;
+	Json::eatWhitespace(p, end);
 
-	Json::eatWhitespace(json, index);
+	if(p == end || *p != '"')
+	{
+		success = false;
+		return QString();
+	}
 
-	c = json[index++];
+	p++;
+	const char *start = p;
 
-	bool complete = false;
-	while(!complete)
+	//Fast path, strings without escape sequences are converted at once
+	while(p != end && *p != '"' && *p != '\\')
 	{
-		if(index == json.size())
+		p++;
+	}
+
+	if(p == end)
+	{
+		success = false;
+		return QString();
+	}
+
+	if(*p == '"')
+	{
+		p++;
+		return QString::fromUtf8(start, p - start - 1);
+	}
+
+	//Unescape into a UTF-8 buffer
+	QByteArray s(start, p - start);
+
+	while(p != end)
+	{
+		char c = *p++;
+
+		if(c == '"')
 		{
-			break;
+			return QString::fromUtf8(s.constData(), s.size());
+		}
+		else if(c != '\\')
+		{
+			s.append(c);
+			continue;
 		}
 
-		c = json[index++];
-
-		if(c == '\"')
+		if(p == end)
 		{
-			complete = true;
 			break;
 		}
-		else if(c == '\\')
-		{
-			if(index == json.size())
-			{
-				break;
-			}
 
-			c = json[index++];
+		c = *p++;
 
-			if(c == '\"')
-			{
-				s.append('\"');
-			}
-			else if(c == '\\')
-			{
-				s.append('\\');
-			}
-			else if(c == '/')
-			{
-				s.append('/');
-			}
-			else if(c == 'b')
-			{
-				s.append('\b');
-			}
-			else if(c == 'f')
-			{
-				s.append('\f');
-			}
-			else if(c == 'n')
-			{
-				s.append('\n');
-			}
-			else if(c == 'r')
-			{
-				s.append('\r');
-			}
-			else if(c == 't')
-			{
-				s.append('\t');
-			}
-			else if(c == 'u')
+		switch(c)
+		{
+			case '"':  s.append('"');  break;
+			case '\\': s.append('\\'); break;
+			case '/':  s.append('/');  break;
+			case 'b':  s.append('\b'); break;
+			case 'f':  s.append('\f'); break;
+			case 'n':  s.append('\n'); break;
+			case 'r':  s.append('\r'); break;
+			case 't':  s.append('\t'); break;
+			case 'u':
 			{
-				int remainingLength = json.size() - index;
-
-				if(remainingLength >= 4)
+				uint u;
+				if(!parseHex4(p, end, u))
 				{
-					QString unicodeStr = json.mid(index, 4);
-
-					int symbol = unicodeStr.toInt(0, 16);
-					
-					s.append(QChar(symbol));
-
-					index += 4;
+					success = false;
+					return QString();
 				}
-				else
+				p += 4;
+
+				//Combine surrogate pairs
+				if((u >= 0xD800) && (u < 0xDC00) && ((end - p) >= 6) && (p[0] == '\\') && (p[1] == 'u'))
 				{
-					break;
+					uint low;
+					if(parseHex4(p + 2, end, low) && (low >= 0xDC00) && (low < 0xE000))
+					{
+						u = 0x10000 + ((u - 0xD800) << 10) + (low - 0xDC00);
+						p += 6;
+					}
 				}
+
+				appendUtf8(s, u);
 			}
+				break;
+			default: //Unknown escape sequences are ignored
+				break;
 		}
-		else
-		{
-			s.append(c);
-		}
-	}
-
-	if(!complete)
-	{
-		success = false;
-		return QVariant();
 	}
 
-	return QVariant(s);
+	//The closing quote is missing
+	success = false;
+	return QString();
 }
 
 /**
  * parseNumber
  */
-QVariant Json::parseNumber(const QString &json, int &index)
+QVariant Json::parseNumber(const char *&p, const char *end)
 {
-	Json::eatWhitespace(json, index);
+	Json::eatWhitespace(p, end);
 
-	int lastIndex = Json::lastIndexOfNumber(json, index);
-	int charLength = (lastIndex - index) + 1;
-	QString numberStr;
+	const char *start = p;
+	bool integer = true;
 
-	numberStr = json.mid(index, charLength);
-	
-	index = lastIndex + 1;
+	for(; p != end; p++)
+	{
+		char c = *p;
 
-	return QVariant(numberStr.toDouble(NULL));
-}
+		if(c >= '0' && c <= '9')
+		{
+			continue;
+		}
+		else if(c == '.' || c == 'e' || c == 'E' || c == '+' || (c == '-' && p != start))
+		{
+			integer = false;
+		}
+		else if(c != '-')
+		{
+			break;
+		}
+	}
 
-/**
- * lastIndexOfNumber
- */
-int Json::lastIndexOfNumber(const QString &json, int index)
-{
-	int lastIndex;
+	int length = p - start;
 
-	for(lastIndex = index; lastIndex < json.size(); lastIndex++)
+	//Fast path for integers which fit into a double without loss
+	if(integer && length > 0 && length <= 15)
 	{
-		if(QString("0123456789+-.eE").indexOf(json[lastIndex]) == -1)
+		const char *i = start;
+		bool negative = (*i == '-');
+		qint64 value = 0;
+
+		if(negative)
 		{
-			break;
+			i++;
+		}
+
+		if(i != p)
+		{
+			for(; i != p; i++)
+			{
+				value = (value * 10) + (*i - '0');
+			}
+
+			return QVariant((double)(negative ? -value : value));
 		}
 	}
 
-	return lastIndex -1;
+	//Invalid numbers result in 0 as before
+	return QVariant(QByteArray::fromRawData(start, length).toDouble(NULL));
 }
 
 /**
  * eatWhitespace
  */
-void Json::eatWhitespace(const QString &json, int &index)
+void Json::eatWhitespace(const char *&p, const char *end)
 {
-	for(; index < json.size(); index++)
+	while(p != end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r'))
 	{
-		if(QString(" \t\n\r").indexOf(json[index]) == -1)
-		{
-			break;
-		}
+		p++;
 	}
 }
 
 /**
  * lookAhead
  */
-int Json::lookAhead(const QString &json, int index)
+int Json::lookAhead(const char *p, const char *end)
 {
-	int saveIndex = index;
-	return Json::nextToken(json, saveIndex);
+	return Json::nextToken(p, end);
 }
 
 /**
  * nextToken
  */
-int Json::nextToken(const QString &json, int &index)
+int Json::nextToken(const char *&p, const char *end)
 {
-	Json::eatWhitespace(json, index);
+	Json::eatWhitespace(p, end);
 
-	if(index == json.size())
+	if(p == end)
 	{
 		return JsonTokenNone;
 	}
 
-	QChar c = json[index];
-	index++;
-	switch(c.toAscii())
+	switch(*p++)
 	{
 		case '{': return JsonTokenCurlyOpen;
 		case '}': return JsonTokenCurlyClose;
@@ -498,43 +465,442 @@ int Json::nextToken(const QString &json, int &index)
 		case ':': return JsonTokenColon;
 	}
 
-	index--;
+	p--;
 
-	int remainingLength = json.size() - index;
+	int remainingLength = end - p;
 
 	//True
-	if(remainingLength >= 4)
+	if(remainingLength >= 4 && qstrncmp(p, "true", 4) == 0)
+	{
+		p += 4;
+		return JsonTokenTrue;
+	}
+
+	//False
+	if(remainingLength >= 5 && qstrncmp(p, "false", 5) == 0)
+	{
+		p += 5;
+		return JsonTokenFalse;
+	}
+
+	//Null
+	if(remainingLength >= 4 && qstrncmp(p, "null", 4) == 0)
 	{
-		if (json[index] == 't' && json[index + 1] == 'r' &&
-			json[index + 2] == 'u' && json[index + 3] == 'e')
+		p += 4;
+		return JsonTokenNull;
+	}
+
+	return JsonTokenNone;
+}
+
+/**
+ * JsonWriter
+ */
+JsonWriter::JsonWriter(QByteArray &buffer) :
+	m_buffer(buffer),
+	m_comma(false),
+	m_success(true)
+{
+}
+
+/**
+ * beginObject
+ */
+void JsonWriter::beginObject()
+{
+	separator();
+	m_buffer.append('{');
+	m_comma = false;
+}
+
+/**
+ * endObject
+ */
+void JsonWriter::endObject()
+{
+	m_buffer.append('}');
+	m_comma = true;
+}
+
+/**
+ * beginArray
+ */
+void JsonWriter::beginArray()
+{
+	separator();
+	m_buffer.append('[');
+	m_comma = false;
+}
+
+/**
+ * endArray
+ */
+void JsonWriter::endArray()
+{
+	m_buffer.append(']');
+	m_comma = true;
+}
+
+/**
+ * key
+ */
+void JsonWriter::key(const char *key)
+{
+	separator();
+	writeString(key);
+	m_buffer.append(':');
+	m_comma = false;
+}
+
+/**
+ * key
+ */
+void JsonWriter::key(const QString &key)
+{
+	separator();
+	writeString(key);
+	m_buffer.append(':');
+	m_comma = false;
+}
+
+/**
+ * null
+ */
+void JsonWriter::null()
+{
+	separator();
+	m_buffer.append("null", 4);
+	m_comma = true;
+}
+
+/**
+ * value
+ */
+void JsonWriter::value(bool value)
+{
+	separator();
+	if (value)
+	{
+		m_buffer.append("true", 4);
+	}
+	else
+	{
+		m_buffer.append("false", 5);
+	}
+	m_comma = true;
+}
+
+/**
+ * value
+ */
+void JsonWriter::value(int value)
+{
+	this->value((qint64)value);
+}
+
+/**
+ * value
+ */
+void JsonWriter::value(uint value)
+{
+	this->value((quint64)value);
+}
+
+/**
+ * value
+ */
+void JsonWriter::value(qint64 value)
+{
+	separator();
+	if (value < 0)
+	{
+		// avoid overflow for the smallest negative number
+		writeInteger((quint64)(-(value + 1)) + 1, true);
+	}
+	else
+	{
+		writeInteger((quint64)value, false);
+	}
+	m_comma = true;
+}
+
+/**
+ * value
+ */
+void JsonWriter::value(quint64 value)
+{
+	separator();
+	writeInteger(value, false);
+	m_comma = true;
+}
+
+/**
+ * value
+ */
+void JsonWriter::value(double value)
+{
+	if (value != value) // NaN can't be represented in JSON
+	{
+		null();
+	}
+	else if ((value > -1e15) && (value < 1e15) && (value == (double)(qint64)value))
+	{
+		this->value((qint64)value);
+	}
+	else if ((value > -1e300) && (value < 1e300))
+	{
+		separator();
+		m_buffer.append(QByteArray::number(value));
+		m_comma = true;
+	}
+	else // infinite
+	{
+		null();
+	}
+}
+
+/**
+ * value
+ */
+void JsonWriter::value(const char *value)
+{
+	separator();
+	writeString(value);
+	m_comma = true;
+}
+
+/**
+ * value
+ */
+void JsonWriter::value(const QString &value)
+{
+	separator();
+	writeString(value);
+	m_comma = true;
+}
+
+/**
+ * value
+ */
+bool JsonWriter::value(const QVariant &data)
+{
+	if (!data.isValid()) // invalid or null?
+	{
+		null();
+	}
+	else if (data.type() == QVariant::List) // variant is a list?
+	{
+		// access the data without copying the list
+		const QVariantList *list = static_cast<const QVariantList*>(data.constData());
+		QVariantList::const_iterator i = list->constBegin();
+		QVariantList::const_iterator end = list->constEnd();
+
+		beginArray();
+		for (; i != end && m_success; ++i)
 		{
-			index += 4;
-			return JsonTokenTrue;
+			value(*i);
 		}
+		endArray();
 	}
+	else if (data.type() == QVariant::StringList) // variant is a string list?
+	{
+		const QStringList *list = static_cast<const QStringList*>(data.constData());
+		QStringList::const_iterator i = list->constBegin();
+		QStringList::const_iterator end = list->constEnd();
 
-	//False
-	if (remainingLength >= 5)
+		beginArray();
+		for (; i != end; ++i)
+		{
+			value(*i);
+		}
+		endArray();
+	}
+	else if (data.type() == QVariant::Map) // variant is a map?
 	{
-		if (json[index] == 'f' && json[index + 1] == 'a' &&
-			json[index + 2] == 'l' && json[index + 3] == 's' &&
-			json[index + 4] == 'e')
+		const QVariantMap *map = static_cast<const QVariantMap*>(data.constData());
+		QVariantMap::const_iterator i = map->constBegin();
+		QVariantMap::const_iterator end = map->constEnd();
+
+		beginObject();
+		for (; i != end && m_success; ++i)
 		{
-			index += 5;
-			return JsonTokenFalse;
+			key(i.key());
+			value(i.value());
 		}
+		endObject();
+	}
+	else if (data.type() == QVariant::String) // a string?
+	{
+		value(*static_cast<const QString*>(data.constData()));
+	}
+	else if (data.type() == QVariant::ByteArray) // a byte array?
+	{
+		value(data.toString());
+	}
+	else if (data.type() == QVariant::Double) // double?
+	{
+		value(data.toDouble());
+	}
+	else if (data.type() == QVariant::Bool) // boolean value?
+	{
+		value(data.toBool());
+	}
+	else if (data.type() == QVariant::ULongLong) // large unsigned number?
+	{
+		value((quint64)data.toULongLong());
+	}
+	else if (data.canConvert<qlonglong>()) // any signed number?
+	{
+		value((qint64)data.toLongLong());
+	}
+	else if (data.canConvert<QString>()) // can value be converted to string?
+	{
+		// this will catch QDate, QDateTime, QUrl, ...
+		value(data.toString());
+	}
+	else
+	{
+		m_success = false;
 	}
 
-	//Null
-	if (remainingLength >= 4)
+	return m_success;
+}
+
+/**
+ * raw
+ */
+void JsonWriter::raw(const QByteArray &json)
+{
+	separator();
+	m_buffer.append(json);
+	m_comma = true;
+}
+
+/**
+ * success
+ */
+bool JsonWriter::success() const
+{
+	return m_success;
+}
+
+/**
+ * separator
+ */
+void JsonWriter::separator()
+{
+	if (m_comma)
+	{
+		m_buffer.append(',');
+	}
+}
+
+/**
+ * writeInteger
+ */
+void JsonWriter::writeInteger(quint64 value, bool negative)
+{
+	char buf[24];
+	char *p = buf + sizeof(buf);
+
+	do
+	{
+		*--p = '0' + (value % 10);
+		value /= 10;
+	} while (value != 0);
+
+	if (negative)
+	{
+		*--p = '-';
+	}
+
+	m_buffer.append(p, (buf + sizeof(buf)) - p);
+}
+
+/**
+ * writeString
+ */
+void JsonWriter::writeString(const QString &str)
+{
+	const QChar *c = str.constData();
+	const QChar *end = c + str.size();
+
+	m_buffer.append('"');
+
+	for (; c != end; ++c)
 	{
-		if (json[index] == 'n' && json[index + 1] == 'u' &&
-			json[index + 2] == 'l' && json[index + 3] == 'l')
+		uint u = c->unicode();
+
+		if (u < 0x80)
+		{
+			writeChar((char)u);
+		}
+		else if (u < 0x800)
+		{
+			m_buffer.append((char)(0xC0 | (u >> 6)));
+			m_buffer.append((char)(0x80 | (u & 0x3F)));
+		}
+		else if (c->isHighSurrogate() && ((c + 1) != end) && (c + 1)->isLowSurrogate())
+		{
+			u = QChar::surrogateToUcs4(c->unicode(), (c + 1)->unicode());
+			++c;
+			m_buffer.append((char)(0xF0 | (u >> 18)));
+			m_buffer.append((char)(0x80 | ((u >> 12) & 0x3F)));
+			m_buffer.append((char)(0x80 | ((u >> 6) & 0x3F)));
+			m_buffer.append((char)(0x80 | (u & 0x3F)));
+		}
+		else
 		{
-			index += 4;
-			return JsonTokenNull;
+			m_buffer.append((char)(0xE0 | (u >> 12)));
+			m_buffer.append((char)(0x80 | ((u >> 6) & 0x3F)));
+			m_buffer.append((char)(0x80 | (u & 0x3F)));
 		}
 	}
 
-	return JsonTokenNone;
+	m_buffer.append('"');
+}
+
+/**
+ * writeString
+ */
+void JsonWriter::writeString(const char *str)
+{
+	m_buffer.append('"');
+
+	for (; *str != '\0'; ++str)
+	{
+		writeChar(*str);
+	}
+
+	m_buffer.append('"');
+}
+
+/**
+ * writeChar
+ */
+void JsonWriter::writeChar(char c)
+{
+	static const char hex[] = "0123456789abcdef";
+
+	switch (c)
+	{
+		case '"':  m_buffer.append("\\\"", 2); break;
+		case '\\': m_buffer.append("\\\\", 2); break;
+		case '\b': m_buffer.append("\\b", 2); break;
+		case '\f': m_buffer.append("\\f", 2); break;
+		case '\n': m_buffer.append("\\n", 2); break;
+		case '\r': m_buffer.append("\\r", 2); break;
+		case '\t': m_buffer.append("\\t", 2); break;
+		default:
+			if ((uchar)c < 0x20) // other control characters
+			{
+				const char esc[6] = { '\\', 'u', '0', '0', hex[(uchar)c >> 4], hex[(uchar)c & 0x0F] };
+				m_buffer.append(esc, 6);
+			}
+			else
+			{
+				m_buffer.append(c);
+			}
+			break;
+	}
 }
@@ -5,6 +5,7 @@
 #ifndef JSON_H
 #define JSON_H
 
+#include <QByteArray>
 #include <QVariant>
 #include <QString>
 
@@ -51,6 +52,14 @@ class Json
 		 */
 		static QVariant parse(const QString &json, bool &success);
 
+		/**
+		 * Parse UTF-8 encoded JSON data
+		 *
+		 * \param json The JSON data
+		 * \param success The success of the parsing
+		 */
+		static QVariant parse(const QByteArray &json, bool &success);
+
 		/**
 		* This method generates a textual JSON representation
 		*
@@ -71,100 +80,240 @@ class Json
 
 	private:
 		/**
-		 * Parses a value starting from index
+		 * Parses a value starting from p
 		 *
-		 * \param json The JSON data
-		 * \param index The start index
+		 * \param p The current position, points behind the value on return
+		 * \param end The end of the JSON data
 		 * \param success The success of the parse process
 		 *
 		 * \return QVariant The parsed value
 		 */
-		static QVariant parseValue(const QString &json, int &index,
+		static QVariant parseValue(const char *&p, const char *end,
 								   bool &success);
 
 		/**
-		 * Parses an object starting from index
+		 * Parses an object starting from p
 		 *
-		 * \param json The JSON data
-		 * \param index The start index
+		 * \param p The current position
+		 * \param end The end of the JSON data
 		 * \param success The success of the object parse
 		 *
 		 * \return QVariant The parsed object map
 		 */
-		static QVariant parseObject(const QString &json, int &index,
-									   bool &success);
+		static QVariant parseObject(const char *&p, const char *end,
+									bool &success);
 
 		/**
-		 * Parses an array starting from index
+		 * Parses an array starting from p
 		 *
-		 * \param json The JSON data
-		 * \param index The starting index
+		 * \param p The current position
+		 * \param end The end of the JSON data
 		 * \param success The success of the array parse
 		 *
 		 * \return QVariant The parsed variant array
 		 */
-		static QVariant parseArray(const QString &json, int &index,
-									   bool &success);
+		static QVariant parseArray(const char *&p, const char *end,
+								   bool &success);
 
 		/**
-		 * Parses a string starting from index
+		 * Parses a string starting from p
 		 *
-		 * \param json The JSON data
-		 * \param index The starting index
+		 * \param p The current position
+		 * \param end The end of the JSON data
 		 * \param success The success of the string parse
 		 *
-		 * \return QVariant The parsed string
+		 * \return QString The parsed string
 		 */
-		static QVariant parseString(const QString &json, int &index,
-									bool &success);
+		static QString parseString(const char *&p, const char *end,
+								   bool &success);
 
 		/**
-		 * Parses a number starting from index
+		 * Parses a number starting from p
 		 *
-		 * \param json The JSON data
-		 * \param index The starting index
+		 * \param p The current position
+		 * \param end The end of the JSON data
 		 *
 		 * \return QVariant The parsed number
 		 */
-		static QVariant parseNumber(const QString &json, int &index);
+		static QVariant parseNumber(const char *&p, const char *end);
 
 		/**
-		 * Get the last index of a number starting from index
+		 * Skip unwanted whitespace symbols starting from p
 		 *
-		 * \param json The JSON data
-		 * \param index The starting index
+		 * \param p The current position
+		 * \param end The end of the JSON data
+		 */
+		static void eatWhitespace(const char *&p, const char *end);
+
+		/**
+		 * Check what token lies ahead
+		 *
+		 * \param p The current position
+		 * \param end The end of the JSON data
 		 *
-		 * \return The last index of the number
+		 * \return int The upcoming token
 		 */
-		static int lastIndexOfNumber(const QString &json, int index);
+		static int lookAhead(const char *p, const char *end);
 
 		/**
-		 * Skip unwanted whitespace symbols starting from index
+		 * Get the next JSON token
 		 *
-		 * \param json The JSON data
-		 * \param index The start index
+		 * \param p The current position
+		 * \param end The end of the JSON data
+		 *
+		 * \return int The next JSON token
 		 */
-		static void eatWhitespace(const QString &json, int &index);
+		static int nextToken(const char *&p, const char *end);
+};
 
+/**
+ * \class JsonWriter
+ * \brief A streaming JSON writer
+ *
+ * JsonWriter appends the textual JSON representation of values directly to
+ * a single buffer. Separators between values are inserted automatically.
+ */
+class JsonWriter
+{
+	public:
 		/**
-		 * Check what token lies ahead
+		 * Constructor
 		 *
-		 * \param json The JSON data
-		 * \param index The starting index
+		 * \param buffer The buffer to which the JSON data is appended
+		 */
+		JsonWriter(QByteArray &buffer);
+
+		/**
+		 * Starts a JSON object
+		 */
+		void beginObject();
+
+		/**
+		 * Finishes the current JSON object
+		 */
+		void endObject();
+
+		/**
+		 * Starts a JSON array
+		 */
+		void beginArray();
+
+		/**
+		 * Finishes the current JSON array
+		 */
+		void endArray();
+
+		/**
+		 * Writes the key of the next object member
 		 *
-		 * \return int The upcoming token
+		 * \param key The key as ASCII or UTF-8 string
 		 */
-		static int lookAhead(const QString &json, int index);
+		void key(const char *key);
 
 		/**
-		 * Get the next JSON token
+		 * Writes the key of the next object member
 		 *
-		 * \param json The JSON data
-		 * \param index The starting index
+		 * \param key The key
+		 */
+		void key(const QString &key);
+
+		/**
+		 * Writes a null value
+		 */
+		void null();
+
+		/**
+		 * Writes a boolean value
+		 */
+		void value(bool value);
+
+		/**
+		 * Writes an integer value
+		 */
+		void value(int value);
+
+		/**
+		 * Writes an unsigned integer value
+		 */
+		void value(uint value);
+
+		/**
+		 * Writes a 64-bit integer value
+		 */
+		void value(qint64 value);
+
+		/**
+		 * Writes a 64-bit unsigned integer value
+		 */
+		void value(quint64 value);
+
+		/**
+		 * Writes a number, integral values are written without fraction
+		 */
+		void value(double value);
+
+		/**
+		 * Writes a string value
 		 *
-		 * \return int The next JSON token
+		 * \param value The string as ASCII or UTF-8 string
+		 */
+		void value(const char *value);
+
+		/**
+		 * Writes a string value
 		 */
-		static int nextToken(const QString &json, int &index);
+		void value(const QString &value);
+
+		/**
+		 * Writes a QVariant hierarchy
+		 *
+		 * \param value The data generated by the parser
+		 *
+		 * \return false if the value can't be represented as JSON
+		 */
+		bool value(const QVariant &value);
+
+		/**
+		 * Writes already serialized JSON data as value
+		 *
+		 * \param json The JSON data
+		 */
+		void raw(const QByteArray &json);
+
+		/**
+		 * \return false if a value couldn't be written
+		 */
+		bool success() const;
+
+	private:
+		/**
+		 * Writes a comma if a value was written before
+		 */
+		void separator();
+
+		/**
+		 * Writes the decimal representation of an integer
+		 */
+		void writeInteger(quint64 value, bool negative);
+
+		/**
+		 * Writes a quoted and escaped UTF-8 string
+		 */
+		void writeString(const QString &str);
+
+		/**
+		 * Writes a quoted and escaped string
+		 */
+		void writeString(const char *str);
+
+		/**
+		 * Writes an ASCII character, escaped if needed
+		 */
+		void writeChar(char c);
+
+		QByteArray &m_buffer;
+		bool m_comma;
+		bool m_success;
 };
 
 #endif //JSON_H
@@ -0,0 +1,58 @@
+/*
+ * Copyright (C) 2013 dresden elektronik ingenieurtechnik gmbh.
+ * All rights reserved.
+ *
+ * The software in this package is published under the terms of the BSD
+ * style license a copy of which has been included with this distribution in
+ * the LICENSE.txt file.
+ *
+ */
+
+#include "json_cache.h"
+
+/*! Constructor.
+ */
+JsonCache::JsonCache() :
+   m_version(0),
+   m_variant(0)
+{
+}
+
+/*! Returns true if the cached data matches \p version and \p variant.
+ */
+bool JsonCache::isValid(quint64 version, int variant) const
+{
+    if (m_data.isEmpty() || (m_variant != variant))
+    {
+        return false;
+    }
+
+    return m_version == version;
+}
+
+/*! Returns the cached JSON data.
+ */
+const QByteArray &JsonCache::data() const
+{
+    return m_data;
+}
+
+/*! Sets the cached JSON data.
+    \param version - the current version of the resource
+    \param variant - the rendering variant
+    \param data - the serialized JSON data
+ */
+void JsonCache::setData(quint64 version, int variant, const QByteArray &data)
+{
+    m_version = version;
+    m_variant = variant;
+    m_data = data;
+}
+
+/*! Invalidates the cached data.
+ */
+void JsonCache::clear()
+{
+    m_version = 0;
+    m_data.clear();
+}
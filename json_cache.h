@@ -0,0 +1,36 @@
+/*
+ * Copyright (C) 2013 dresden elektronik ingenieurtechnik gmbh.
+ * All rights reserved.
+ *
+ * The software in this package is published under the terms of the BSD
+ * style license a copy of which has been included with this distribution in
+ * the LICENSE.txt file.
+ *
+ */
+
+#ifndef JSON_CACHE_H
+#define JSON_CACHE_H
+
+#include <QByteArray>
+
+/*! \class JsonCache
+
+    Holds the serialized JSON representation of a resource.
+    The data is valid as long as the version of the resource doesn't change.
+ */
+class JsonCache
+{
+public:
+    JsonCache();
+    bool isValid(quint64 version, int variant) const;
+    const QByteArray &data() const;
+    void setData(quint64 version, int variant, const QByteArray &data);
+    void clear();
+
+private:
+    quint64 m_version; // version of the resource when data was created
+    int m_variant; // distinguishes different renderings, e.g. ApiVersion
+    QByteArray m_data;
+};
+
+#endif // JSON_CACHE_H
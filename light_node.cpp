@@ -13,7 +13,9 @@
 /*! Constructor.
  */
 LightNode::LightNode() :
+   version(0),
    m_lastRead(0),
+   m_lastReport(-1),
    m_groupCapacity(0),
    m_read(0),
    m_manufacturer("Unknown"),
@@ -27,7 +29,8 @@ LightNode::LightNode() :
    m_sat(0),
    m_colorX(0),
    m_colorY(0),
-   m_colorMode("hs")
+   m_colorMode("hs"),
+   m_readDue(-1)
 {
 }
 
@@ -396,19 +399,27 @@ void LightNode::setGroupCapacity(uint8_t capacity)
     m_groupCapacity = capacity;
 }
 
-/*! Returns the time than the next auto reading is queued.
+/*! Returns the bitmap of READ_* flags which are not processed yet.
  */
-const QTime &LightNode::nextReadTime() const
+uint32_t LightNode::readFlags() const
 {
-    return m_nextReadTime;
+    return m_read;
 }
 
-/*! Sets the time than the next auto reading should be queued.
-    \param time the time for reading
+/*! Returns the time than the queued reads are due or -1 if the node isn't
+    in the read queue.
  */
-void LightNode::setNextReadTime(const QTime &time)
+qint64 LightNode::readDue() const
 {
-    m_nextReadTime = time;
+    return m_readDue;
+}
+
+/*! Sets the time than the queued reads are due.
+    \param due ms of starttimeRef, -1 if the node isn't in the read queue
+ */
+void LightNode::setReadDue(qint64 due)
+{
+    m_readDue = due;
 }
 
 /*! Returns the value of the idleTotalCounter than the last reading happend.
@@ -425,3 +436,19 @@ void LightNode::setLastRead(int lastRead)
 {
     m_lastRead = lastRead;
 }
+
+/*! Returns the value of the idleTotalCounter than the last attribute report
+    was received or -1 if the light never reported.
+ */
+int LightNode::lastReport() const
+{
+    return m_lastReport;
+}
+
+/*! Sets the last report counter.
+    \param lastReport copy of idleTotalCounter
+ */
+void LightNode::setLastReport(int lastReport)
+{
+    m_lastReport = lastReport;
+}
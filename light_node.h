@@ -15,6 +15,7 @@
 #include <deconz.h>
 #include "rest_node_base.h"
 #include "group_info.h"
+#include "json_cache.h"
 
 #define READ_MODEL_ID          (1 << 0)
 #define READ_SWBUILD_ID        (1 << 1)
@@ -23,6 +24,7 @@
 #define READ_COLOR             (1 << 4)
 #define READ_GROUPS            (1 << 5)
 #define READ_SCENES            (1 << 6)
+#define CONFIGURE_REPORTING    (1 << 7) // bind and configure attribute reporting
 
 /*! \class LightNode
 
@@ -67,19 +69,25 @@ public:
     void clearRead(uint32_t readFlags);
     uint8_t groupCapacity() const;
     void setGroupCapacity(uint8_t capacity);
-    const QTime &nextReadTime() const;
-    void setNextReadTime(const QTime &time);
+    uint32_t readFlags() const;
+    qint64 readDue() const;
+    void setReadDue(qint64 due);
     int lastRead() const;
     void setLastRead(int lastRead);
+    int lastReport() const;
+    void setLastReport(int lastReport);
 
     QString etag;
+    quint64 version; // resource version of the last change
+    JsonCache jsonCache; // serialized light state
 
 private:
     int m_lastRead; // copy of idleTotalCounter
+    int m_lastReport; // copy of idleTotalCounter, -1 if the light never reported
     uint8_t m_groupCapacity;
     QString m_name;
     QString m_type;
-    uint32_t m_read; // bitmap of READ_* flags
+    uint32_t m_read; // bitmap of READ_* and CONFIGURE_REPORTING flags
     QString m_manufacturer;
     uint16_t m_manufacturerCode;
     QString m_modelId;
@@ -96,7 +104,7 @@ private:
     uint16_t m_colorY;
     QString m_colorMode;
     deCONZ::SimpleDescriptor m_haEndpoint;
-    QTime m_nextReadTime;
+    qint64 m_readDue; // ms of starttimeRef, -1 if not in the read queue
 };
 
 #endif // LIGHT_NODE_H
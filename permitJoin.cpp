@@ -16,12 +16,8 @@
  */
 void DeRestPluginPrivate::initPermitJoin()
 {
-    permitJoinTimer = new QTimer(this);
-    permitJoinTimer->setSingleShot(false);
-    connect(permitJoinTimer, SIGNAL(timeout()),
-            this, SLOT(permitJoinTimerFired()));
-    permitJoinTimer->start(1000);
     permitJoinLastSendTime = QTime::currentTime();
+    scheduleJob(JobPermitJoin, HOUSEKEEPING_TICK);
 }
 
 /*! Sets the permit join interval
@@ -41,6 +37,7 @@ bool DeRestPluginPrivate::setPermitJoinDuration(uint8_t duration)
 
         // force resend
         permitJoinLastSendTime = QTime();
+        scheduleJob(JobPermitJoin, 0);
     }
     return true;
 }
@@ -68,7 +65,7 @@ void DeRestPluginPrivate::permitJoinTimerFired()
     if (!permitJoinLastSendTime.isValid() || (diff > PERMIT_JOIN_SEND_INTERVAL))
     {
         // only send if nothing else todo
-        if (tasks.empty() && runningTasks.empty())
+        if (taskQueue.isEmpty())
         {
             deCONZ::ApsDataRequest apsReq;
             quint8 tcSignificance = 0x01;
@@ -0,0 +1,237 @@
+/*
+ * Copyright (C) 2013 dresden elektronik ingenieurtechnik gmbh.
+ * All rights reserved.
+ *
+ * The software in this package is published under the terms of the BSD
+ * style license a copy of which has been included with this distribution in
+ * the LICENSE.txt file.
+ *
+ */
+
+#include <QString>
+#include <QVariantMap>
+#include <algorithm>
+#include "de_web_plugin.h"
+#include "de_web_plugin_private.h"
+
+/*! Inits the polling scheduler.
+    The share of the radio budget can be set with --rest-poll-share (percent).
+ */
+void DeRestPluginPrivate::initPolling()
+{
+    pollShare = deCONZ::appArgumentNumeric("--rest-poll-share", POLL_SHARE_DEFAULT);
+
+    if ((pollShare < 0) || (pollShare > 100))
+    {
+        pollShare = POLL_SHARE_DEFAULT;
+    }
+
+    pollCredit = 0;
+}
+
+/*! Returns true if a light sent attribute reports within REPORT_TIMEOUT seconds.
+ */
+bool DeRestPluginPrivate::isReporting(const LightNode *lightNode) const
+{
+    return (lightNode->lastReport() >= 0) &&
+           (lightNode->lastReport() >= (idleTotalCounter - REPORT_TIMEOUT));
+}
+
+/*! Returns the seconds since the state of a light was last refreshed,
+    either by reading or by an attribute report.
+ */
+int DeRestPluginPrivate::lightStaleness(const LightNode *lightNode) const
+{
+    int last = lightNode->lastRead();
+
+    if (isReporting(lightNode))
+    {
+        last = qMax(last, lightNode->lastReport());
+    }
+
+    return idleTotalCounter - last;
+}
+
+/*! Returns the polling priority of a light, 0 if it doesn't need a refresh.
+
+    The priority grows with the seconds since the last read and is weighted
+    by the importance of the light. Reporting lights only need their groups
+    and scenes refreshed every POLL_REPORTING_AGE seconds.
+ */
+int DeRestPluginPrivate::pollPriority(const LightNode *lightNode) const
+{
+    int age = idleTotalCounter - lightNode->lastRead();
+
+    if (isReporting(lightNode))
+    {
+        return (age >= POLL_REPORTING_AGE) ? age : 0;
+    }
+
+    if (age < IDLE_READ_LIMIT)
+    {
+        return 0;
+    }
+
+    int weight = 2;
+
+    if (lightNode->modelId().isEmpty() || lightNode->swBuildId().isEmpty())
+    {
+        weight += 2; // incomplete lights first
+    }
+
+    if (lightNode->isOn())
+    {
+        weight += 1; // wrong state of a lit light is more obvious
+    }
+
+    return age * weight;
+}
+
+/*! Returns the estimated number of frames needed to refresh a light.
+ */
+int DeRestPluginPrivate::pollCost(const LightNode *lightNode) const
+{
+    int frames = 1 + lightNode->groups().size(); // group and scene membership
+
+    if (!isReporting(lightNode))
+    {
+        frames += lightNode->hasColor() ? 3 : 2; // on/off, level, color
+    }
+
+    if (lightNode->modelId().isEmpty())
+    {
+        frames++;
+    }
+
+    if (lightNode->swBuildId().isEmpty())
+    {
+        frames++;
+    }
+
+    return frames;
+}
+
+/*! Refreshes the lights with the highest polling priority.
+
+    Called once per second. Each second pollShare percent of
+    RADIO_FRAMES_PER_SECOND are added to the polling credit which is
+    spent on the estimated frames of the refreshed lights. While the user
+    is active only half of it is added and while the task queue holds
+    more than POLL_BUSY_QUEUED tasks polling pauses, so user commands
+    aren't delayed.
+ */
+void DeRestPluginPrivate::pollLights()
+{
+    int gain = pollShare * RADIO_FRAMES_PER_SECOND; // 1/100 frames
+
+    if (idleLastActivity < IDLE_USER_LIMIT)
+    {
+        gain /= 2;
+    }
+
+    pollCredit = qMin(pollCredit + gain, POLL_MAX_CREDIT * 100);
+
+    if ((pollCredit <= 0) || (taskQueue.queuedCount() > POLL_BUSY_QUEUED))
+    {
+        return;
+    }
+
+    std::vector<std::pair<int, LightNode*> > due;
+
+    std::vector<LightNode>::iterator i = nodes.begin();
+    std::vector<LightNode>::iterator end = nodes.end();
+
+    for (; i != end; ++i)
+    {
+        if (!i->isAvailable())
+        {
+            continue; // wouldn't answer anyway
+        }
+
+        int priority = pollPriority(&(*i));
+
+        if (priority > 0)
+        {
+            due.push_back(std::make_pair(priority, &(*i)));
+        }
+    }
+
+    if (due.empty())
+    {
+        return;
+    }
+
+    std::sort(due.begin(), due.end(), std::greater<std::pair<int, LightNode*> >());
+
+    std::vector<std::pair<int, LightNode*> >::iterator di = due.begin();
+    std::vector<std::pair<int, LightNode*> >::iterator dend = due.end();
+
+    for (; di != dend; ++di)
+    {
+        LightNode *lightNode = di->second;
+        int cost = pollCost(lightNode) * 100;
+
+        // strict priority order, a light costing more than the max. credit goes into debt
+        if (pollCredit < qMin(cost, POLL_MAX_CREDIT * 100))
+        {
+            break;
+        }
+
+        pollCredit -= cost;
+
+        if (isReporting(lightNode))
+        {
+            lightNode->enableRead(READ_GROUPS | READ_SCENES);
+        }
+        else
+        {
+            lightNode->enableRead(READ_ON_OFF | READ_LEVEL | READ_COLOR | READ_GROUPS | READ_SCENES);
+        }
+
+        if (lightNode->modelId().isEmpty())
+        {
+            lightNode->enableRead(READ_MODEL_ID);
+        }
+        if (lightNode->swBuildId().isEmpty())
+        {
+            lightNode->enableRead(READ_SWBUILD_ID);
+        }
+
+        DBG_Printf(DBG_INFO, "Force read attributes for node %s, stale since %d s\n", qPrintable(lightNode->name()), lightStaleness(lightNode));
+        lightNode->setLastRead(idleTotalCounter);
+        scheduleRead(lightNode, 0);
+    }
+}
+
+/*! GET /api/<apikey>/polling
+
+    Returns the state of the polling scheduler and for each light the
+    seconds since its state was refreshed.
+    \return REQ_READY_SEND
+ */
+int DeRestPluginPrivate::getPollingState(const ApiRequest &req, ApiResponse &rsp)
+{
+    Q_UNUSED(req);
+
+    QVariantMap lights;
+
+    std::vector<LightNode>::const_iterator i = nodes.begin();
+    std::vector<LightNode>::const_iterator end = nodes.end();
+
+    for (; i != end; ++i)
+    {
+        QVariantMap light;
+        light["staleness"] = (double)lightStaleness(&(*i));
+        light["reporting"] = isReporting(&(*i));
+        light["priority"] = (double)(i->isAvailable() ? pollPriority(&(*i)) : 0);
+        lights[i->id()] = light;
+    }
+
+    rsp.map["share"] = (double)pollShare;
+    rsp.map["credit"] = (double)pollCredit / 100.0;
+    rsp.map["queued"] = (double)taskQueue.queuedCount();
+    rsp.map["lights"] = lights;
+    rsp.httpStatus = HttpStatusOk;
+
+    return REQ_READY_SEND;
+}
@@ -0,0 +1,118 @@
+/*
+ * Copyright (C) 2013 dresden elektronik ingenieurtechnik gmbh.
+ * All rights reserved.
+ *
+ * The software in this package is published under the terms of the BSD
+ * style license a copy of which has been included with this distribution in
+ * the LICENSE.txt file.
+ *
+ */
+
+#include <QString>
+#include <QTcpSocket>
+#include <QHttpRequestHeader>
+#include <QVariantMap>
+#include "de_web_plugin.h"
+#include "de_web_plugin_private.h"
+#include "json.h"
+
+/*! PUT /api/<apikey>/batch
+
+    Executes several light state and group action requests at once.
+    The body is an array of operations:
+
+    [{ "address": "/lights/1/state", "body": { "on": true } },
+     { "address": "/groups/2/action", "method": "PUT", "body": { "bri": 100 } }]
+
+    The address may also start with /api/<apikey>, "method" defaults to PUT.
+    The apikey is checked once and all commands are queued before the first
+    one is sent. The response has one entry per operation with its address,
+    HTTP status code and the response of the single request.
+    \return REQ_READY_SEND
+ */
+int DeRestPluginPrivate::handleBatch(const ApiRequest &req, ApiResponse &rsp)
+{
+    bool ok;
+    QVariant var = Json::parse(req.content, ok);
+    QVariantList operations = var.toList();
+
+    if (!ok || (var.type() != QVariant::List))
+    {
+        rsp.httpStatus = HttpStatusBadRequest;
+        rsp.list.append(errorToMap(ERR_INVALID_JSON, "/batch", "body contains invalid JSON"));
+        return REQ_READY_SEND;
+    }
+
+    if (operations.isEmpty() || (operations.size() > BATCH_MAX_OPERATIONS))
+    {
+        rsp.httpStatus = HttpStatusBadRequest;
+        rsp.list.append(errorToMap(ERR_INVALID_VALUE, "/batch", QString("invalid value, %1, for number of operations, 1..%2 are allowed").arg(operations.size()).arg(BATCH_MAX_OPERATIONS)));
+        return REQ_READY_SEND;
+    }
+
+    QString prefix = QString("/api/%1").arg(req.apikey());
+
+    QVariantList::const_iterator i = operations.begin();
+    QVariantList::const_iterator end = operations.end();
+
+    for (; i != end; ++i)
+    {
+        QVariantMap op = i->toMap();
+        QString address = op["address"].toString();
+        QString method = op.contains("method") ? op["method"].toString() : QString("PUT");
+        ApiResponse opRsp;
+
+        opRsp.httpStatus = HttpStatusBadRequest;
+
+        if (address.isEmpty() || method.isEmpty() || (op["body"].type() != QVariant::Map))
+        {
+            opRsp.list.append(errorToMap(ERR_MISSING_PARAMETER, "/batch", "missing parameters in operation"));
+        }
+        else
+        {
+            QString fullAddress = address.startsWith("/api/") ? address : (prefix + address);
+            QHttpRequestHeader hdr(method, fullAddress);
+            RestPath restPath;
+            restPath.parse(hdr.path().toLatin1());
+            QStringList path = restPath.toStringList();
+            const RestRoute *route = router.match(method, restPath);
+
+            // only light state and group action requests of the same apikey are allowed
+            if (!route ||
+                ((route->handler != &DeRestPluginPrivate::setLightState) && (route->handler != &DeRestPluginPrivate::setGroupState)) ||
+                (path.at(1) != req.apikey()))
+            {
+                opRsp.httpStatus = HttpStatusNotFound;
+                opRsp.list.append(errorToMap(ERR_RESOURCE_NOT_AVAILABLE, address, QString("resource, %1, not available").arg(address)));
+            }
+            else
+            {
+                ApiRequest opReq(hdr, path, req.sock, QByteArray());
+                opReq.body = op["body"]; // parsed already
+                opReq.batch = true;
+                opReq.version = req.version;
+                (this->*(route->handler))(opReq, opRsp);
+            }
+        }
+
+        QVariantMap result;
+        result["address"] = address;
+        result["status"] = QByteArray(opRsp.httpStatus).left(3).toInt();
+
+        if (!opRsp.map.isEmpty())
+        {
+            result["response"] = opRsp.map;
+        }
+        else
+        {
+            result["response"] = opRsp.list;
+        }
+
+        rsp.list.append(result);
+    }
+
+    processTasks();
+
+    rsp.httpStatus = HttpStatusOk;
+    return REQ_READY_SEND;
+}
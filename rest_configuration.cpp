@@ -16,69 +16,13 @@
 #include <QHttpRequestHeader>
 #include <QVariantMap>
 #include <QNetworkInterface>
+#include <QSet>
+#include <QUrl>
 #include "de_web_plugin.h"
 #include "de_web_plugin_private.h"
 #include "json.h"
 
 
-/*! Configuration REST API broker.
-    \param req - request data
-    \param rsp - response data
-    \return REQ_READY_SEND
-            REQ_NOT_HANDLED
- */
-int DeRestPluginPrivate::handleConfigurationApi(const ApiRequest &req, ApiResponse &rsp)
-{
-    // POST /api
-    if ((req.path.size() == 1) && (req.hdr.method() == "POST"))
-    {
-        return createUser(req, rsp);
-    }
-
-    // GET /api/<apikey>
-    if ((req.path.size() == 2) && (req.hdr.method() == "GET"))
-    {
-        return getFullState(req, rsp);
-    }
-    // GET /api/<apikey>/config
-    else if ((req.path.size() == 3) && (req.hdr.method() == "GET") && (req.path[2] == "config"))
-    {
-        return getConfig(req, rsp);
-    }
-    // PUT /api/<apikey>/config
-    else if ((req.path.size() == 3) && (req.hdr.method() == "PUT") && (req.path[2] == "config"))
-    {
-        return modifyConfig(req, rsp);
-    }
-    // DELETE /api/<apikey>/config/whitelist/<username2>
-    else if ((req.path.size() == 5) && (req.hdr.method() == "DELETE") && (req.path[2] == "config") && (req.path[3] == "whitelist"))
-    {
-        // TODO deleteUser()
-    }
-    // POST /api/<apikey>/config/update
-    else if ((req.path.size() == 4) && (req.hdr.method() == "POST") && (req.path[2] == "config") && (req.path[3] == "update"))
-    {
-        return updateSoftware(req, rsp);
-    }
-    // POST /api/<apikey>/config/updatefirmware
-    else if ((req.path.size() == 4) && (req.hdr.method() == "POST") && (req.path[2] == "config") && (req.path[3] == "updatefirmware"))
-    {
-        return updateFirmware(req, rsp);
-    }
-    // PUT /api/<apikey>/config/password
-    else if ((req.path.size() == 4) && (req.hdr.method() == "PUT") && (req.path[2] == "config") && (req.path[3] == "password"))
-    {
-        return changePassword(req, rsp);
-    }
-    // DELETE /api/config/password
-    else if ((req.path.size() == 3) && (req.hdr.method() == "DELETE") && (req.path[1] == "config") && (req.path[2] == "password"))
-    {
-        return deletePassword(req, rsp);
-    }
-
-    return REQ_NOT_HANDLED;
-}
-
 /*! POST /api
     \return REQ_READY_SEND
             REQ_NOT_HANDLED
@@ -134,17 +78,7 @@ int DeRestPluginPrivate::createUser(const ApiRequest &req, ApiResponse &rsp)
         auth.apikey = map["username"].toString();
 
         // check if this apikey is already known
-        std::vector<ApiAuth>::const_iterator i = apiAuths.begin();
-        std::vector<ApiAuth>::const_iterator end = apiAuths.end();
-
-        for (; i != end; ++i)
-        {
-            if (auth.apikey == i->apikey)
-            {
-                found = true;
-                break;
-            }
-        }
+        found = (getApiAuthForKey(auth.apikey) != 0);
     }
     else
     {
@@ -169,9 +103,9 @@ int DeRestPluginPrivate::createUser(const ApiRequest &req, ApiResponse &rsp)
     {
         auth.createDate = QDateTime::currentDateTimeUtc();
         auth.lastUseDate = QDateTime::currentDateTimeUtc();
-        apiAuths.push_back(auth);
+        auth.needSaveDatabase = true;
+        addApiAuth(auth); // updates the config ETag
         queSaveDb(DB_AUTH, DB_SHORT_SAVE_DELAY);
-        updateEtag(gwConfigEtag);
         DBG_Printf(DBG_INFO, "created username: %s, devicetype: %s\n", qPrintable(auth.apikey), qPrintable(auth.devicetype));
     }
     else
@@ -188,11 +122,73 @@ int DeRestPluginPrivate::createUser(const ApiRequest &req, ApiResponse &rsp)
  */
 void DeRestPluginPrivate::configToMap(QVariantMap &map)
 {
-    bool ok;
     QVariantMap whitelist;
     QVariantMap swupdate;
     QDateTime datetime = QDateTime::currentDateTime();
 
+    // enumerating the network interfaces is expensive, refresh only from time to time
+    if (!gwNetworkInfoTime.isValid() || gwIpAddress.isEmpty() ||
+        (gwNetworkInfoTime.elapsed() > NETWORK_INFO_REFRESH_INTERVAL))
+    {
+        updateNetworkInfo();
+    }
+
+    map["ipaddress"] = gwIpAddress;
+    map["netmask"] = gwNetmask;
+    map["mac"] = gwMac;
+
+    std::vector<ApiAuth>::const_iterator i = apiAuths.begin();
+    std::vector<ApiAuth>::const_iterator end = apiAuths.end();
+    for (; i != end; ++i)
+    {
+        QVariantMap au;
+        au["last use date"] = i->lastUseDate.toString("yyyy-MM-ddTHH:mm:ss"); // ISO 8601
+        au["create date"] = i->createDate.toString("yyyy-MM-ddTHH:mm:ss"); // ISO 8601
+        au["name"] = i->devicetype;
+        whitelist[i->apikey] = au;
+    }
+
+    map["name"] = gwName;
+    map["uuid"] = gwUuid;
+    map["port"] = (double)deCONZ::appArgumentNumeric("--http-port", 80);
+    map["dhcp"] = true; // dummy
+    map["gateway"] = "192.168.178.1"; // TODO
+    map["proxyaddress"] = ""; // dummy
+    map["proxyport"] = (double)0; // dummy
+    map["utc"] = datetime.toString("yyyy-MM-ddTHH:mm:ss"); // ISO 8601
+    map["whitelist"] = whitelist;
+    map["swversion"] = GW_SW_VERSION;
+    map["fwversion"] = gwFirmwareVersion;
+    map["fwneedupdate"] = gwFirmwareNeedUpdate;
+    map["announceurl"] = gwAnnounceUrl;
+    map["announceinterval"] = (double)gwAnnounceInterval;
+    map["rfconnected"] = gwRfConnected;
+    map["permitjoin"] = (double)gwPermitJoinDuration;
+    map["otauactive"] = gwOtauActive;
+    map["otaustate"] = (isOtauBusy() ? "busy" : (gwOtauActive ? "idle" : "off"));
+    map["groupdelay"] = (double)gwGroupSendDelay;
+    map["taskexpired"] = (double)taskQueue.expiredCount();
+    map["discovery"] = (gwAnnounceInterval > 0);
+    map["updatechannel"] = gwUpdateChannel;
+    swupdate["version"] = gwUpdateVersion;
+    swupdate["updatestate"] = (double)0;
+    swupdate["url"] = "";
+    swupdate["text"] = "";
+    swupdate["notify"] = false;
+    map["swupdate"] = swupdate;
+
+    map["linkbutton"] = gwLinkButton;
+    map["portalservices"] = false;
+
+    gwPort = map["port"].toDouble(); // cache
+}
+
+/*! Looks up and caches ip address, netmask and mac address of the first
+    available network interface.
+ */
+void DeRestPluginPrivate::updateNetworkInfo()
+{
+    bool ok;
     QNetworkInterface eth;
 
     {
@@ -229,68 +225,25 @@ void DeRestPluginPrivate::configToMap(QVariantMap &map)
         {
             if (i->ip().protocol() == QAbstractSocket::IPv4Protocol)
             {
-                map["ipaddress"] = i->ip().toString();
-                map["netmask"] = i->netmask().toString();
+                gwIpAddress = i->ip().toString();
+                gwNetmask = i->netmask().toString();
                 ok = true;
                 break;
             }
         }
 
-        map["mac"] = eth.hardwareAddress();
+        gwMac = eth.hardwareAddress();
     }
 
     if (!ok)
     {
-        map["mac"] = "38:60:77:7c:53:18";
-        map["ipaddress"] = "127.0.0.1";
-        map["netmask"] = "255.0.0.0";
+        gwMac = "38:60:77:7c:53:18";
+        gwIpAddress = "127.0.0.1";
+        gwNetmask = "255.0.0.0";
         DBG_Printf(DBG_ERROR, "No valid ethernet interface found\n");
     }
 
-    std::vector<ApiAuth>::const_iterator i = apiAuths.begin();
-    std::vector<ApiAuth>::const_iterator end = apiAuths.end();
-    for (; i != end; ++i)
-    {
-        QVariantMap au;
-        au["last use date"] = i->lastUseDate.toString("yyyy-MM-ddTHH:mm:ss"); // ISO 8601
-        au["create date"] = i->createDate.toString("yyyy-MM-ddTHH:mm:ss"); // ISO 8601
-        au["name"] = i->devicetype;
-        whitelist[i->apikey] = au;
-    }
-
-    map["name"] = gwName;
-    map["uuid"] = gwUuid;
-    map["port"] = (double)deCONZ::appArgumentNumeric("--http-port", 80);
-    map["dhcp"] = true; // dummy
-    map["gateway"] = "192.168.178.1"; // TODO
-    map["proxyaddress"] = ""; // dummy
-    map["proxyport"] = (double)0; // dummy
-    map["utc"] = datetime.toString("yyyy-MM-ddTHH:mm:ss"); // ISO 8601
-    map["whitelist"] = whitelist;
-    map["swversion"] = GW_SW_VERSION;
-    map["fwversion"] = gwFirmwareVersion;
-    map["fwneedupdate"] = gwFirmwareNeedUpdate;
-    map["announceurl"] = gwAnnounceUrl;
-    map["announceinterval"] = (double)gwAnnounceInterval;
-    map["rfconnected"] = gwRfConnected;
-    map["permitjoin"] = (double)gwPermitJoinDuration;
-    map["otauactive"] = gwOtauActive;
-    map["otaustate"] = (isOtauBusy() ? "busy" : (gwOtauActive ? "idle" : "off"));
-    map["groupdelay"] = (double)gwGroupSendDelay;
-    map["discovery"] = (gwAnnounceInterval > 0);
-    map["updatechannel"] = gwUpdateChannel;
-    swupdate["version"] = gwUpdateVersion;
-    swupdate["updatestate"] = (double)0;
-    swupdate["url"] = "";
-    swupdate["text"] = "";
-    swupdate["notify"] = false;
-    map["swupdate"] = swupdate;
-
-    map["linkbutton"] = gwLinkButton;
-    map["portalservices"] = false;
-
-    gwIpAddress = map["ipaddress"].toString(); // cache
-    gwPort = map["port"].toDouble(); // cache
+    gwNetworkInfoTime.start();
 }
 
 /*! GET /api/<apikey>
@@ -306,12 +259,15 @@ int DeRestPluginPrivate::getFullState(const ApiRequest &req, ApiResponse &rsp)
 
     checkRfConnectState();
 
+    // the full state changes whenever any resource gets a new version
+    QString fullStateEtag = etagForVersion(gwGeneration);
+
     // handle ETag
     if (req.hdr.hasKey("If-None-Match"))
     {
         QString etag = req.hdr.value("If-None-Match");
 
-        if (gwConfigEtag == etag)
+        if (fullStateEtag == etag)
         {
             rsp.httpStatus = HttpStatusNotModified;
             rsp.etag = etag;
@@ -319,30 +275,74 @@ int DeRestPluginPrivate::getFullState(const ApiRequest &req, ApiResponse &rsp)
         }
     }
 
-    QVariantMap lights;
-    QVariantMap groups;
-    QVariantMap config;
-    QVariantMap schedules;
+    const QByteArray &snapshot = fullStateSnapshot(req.apiVersion());
+    QDateTime datetime = QDateTime::currentDateTime();
 
-    // lights
-    {
-        std::vector<LightNode>::const_iterator i = this->nodes.begin();
-        std::vector<LightNode>::const_iterator end = this->nodes.end();
+    JsonWriter json(rsp.data);
 
-        for (; i != end; ++i)
-        {
-            QVariantMap map;
-            if (lightToMap(req, &(*i), map))
-            {
-                lights[i->id()] = map;
-            }
-        }
+    rsp.data.reserve(snapshot.size() + 64);
+    json.beginObject();
+    json.key("config");
+    json.beginObject();
+    json.key("utc");
+    json.value(datetime.toString("yyyy-MM-ddTHH:mm:ss")); // ISO 8601
+    rsp.data.append(snapshot);
+    rsp.etag = fullStateEtag;
+    rsp.httpStatus = HttpStatusOk;
+    return REQ_READY_SEND;
+}
+
+/*! Returns the full state snapshot, it will be recreated if outdated.
+    \param apiVersion - the API version requested by the client
+ */
+const QByteArray &DeRestPluginPrivate::fullStateSnapshot(ApiVersion apiVersion)
+{
+    // The snapshot is valid as long as no version was handed out since its creation.
+    // The utc field is the only one which changes without a version update,
+    // it's placed in front of the cached data on each request.
+    if (fullStateData.isEmpty() ||
+        (fullStateGeneration != gwGeneration) ||
+        (fullStateApiVersion != apiVersion) ||
+        (fullStatePermitJoin != gwPermitJoinDuration) ||
+        (fullStateOtauBusy != isOtauBusy()))
+    {
+        updateFullState(apiVersion);
     }
 
+    return fullStateData;
+}
+
+/*! Creates the serialized full state snapshot used by GET /api/<apikey>.
+
+    The snapshot holds everything which follows the utc field of the config
+    object, i.e. the remaining config fields, lights, groups and schedules.
+    \param apiVersion - the API version requested by the client
+ */
+void DeRestPluginPrivate::updateFullState(ApiVersion apiVersion)
+{
+    QVariantMap config;
+    JsonWriter json(fullStateData);
+
+    configToMap(config);
+    config.remove("utc");
+
+    QByteArray configData = Json::serialize(config);
+
+    DBG_Assert(configData.startsWith('{'));
+
+    // continue the config object after the utc field written by getFullState()
+    fullStateData.clear();
+    fullStateData.reserve(configData.size() + ((nodes.size() + groups.size()) * 512));
+    fullStateData.append(',');
+    fullStateData.append(configData.constData() + 1, configData.size() - 1);
+    fullStateData.append(',');
+
     // groups
+    json.key("groups");
+    json.beginObject();
     {
-        std::vector<Group>::const_iterator i = this->groups.begin();
-        std::vector<Group>::const_iterator end = this->groups.end();
+        std::vector<Group>::iterator i = this->groups.begin();
+        std::vector<Group>::iterator end = this->groups.end();
 
         for (; i != end; ++i)
         {
@@ -354,26 +354,192 @@ int DeRestPluginPrivate::getFullState(const ApiRequest &req, ApiResponse &rsp)
 
             if (i->id() != "0")
             {
-                QVariantMap map;
-                if (groupToMap(&(*i), map))
-                {
-                    groups[i->id()] = map;
-                }
+                json.key(i->id());
+                json.raw(groupToJson(&(*i))); // cached per group
             }
         }
     }
+    json.endObject();
 
-    configToMap(config);
+    // lights
+    json.key("lights");
+    json.beginObject();
+    {
+        std::vector<LightNode>::iterator i = this->nodes.begin();
+        std::vector<LightNode>::iterator end = this->nodes.end();
 
-    rsp.map["lights"] = lights;
-    rsp.map["groups"] = groups;
-    rsp.map["config"] = config;
-    rsp.map["schedules"] = schedules;
-    rsp.etag = gwConfigEtag;
+        for (; i != end; ++i)
+        {
+            json.key(i->id());
+            json.raw(lightToJson(apiVersion, &(*i))); // cached per light
+        }
+    }
+    json.endObject();
+
+    json.key("schedules");
+    json.beginObject();
+    json.endObject();
+    json.endObject();
+
+    fullStateGeneration = gwGeneration;
+    fullStateApiVersion = apiVersion;
+    fullStatePermitJoin = gwPermitJoinDuration;
+    fullStateOtauBusy = isOtauBusy();
+}
+
+/*! GET /api/<apikey>/changes?since=<generation>
+
+    Returns the config, lights and groups which were changed after the
+    generation \p since. The generation of the response must be used as
+    \p since for the next request. Deleted groups are reported as null.
+
+    If the change log doesn't reach back to \p since or the parameter is
+    missing, the full state is returned and "full" is set to true.
+    \return REQ_READY_SEND
+            REQ_NOT_HANDLED
+ */
+int DeRestPluginPrivate::getChanges(const ApiRequest &req, ApiResponse &rsp)
+{
+    bool ok = false;
+    quint64 since = 0;
+    QUrl url(req.hdr.path());
+
+    if (url.hasQueryItem("since"))
+    {
+        since = url.queryItemValue("since").toULongLong(&ok);
+
+        if (!ok)
+        {
+            rsp.httpStatus = HttpStatusBadRequest;
+            rsp.list.append(errorToMap(ERR_INVALID_VALUE, "/changes", QString("invalid value, %1, for parameter, since").arg(url.queryItemValue("since"))));
+            return REQ_READY_SEND;
+        }
+    }
+
+    changesToJson(rsp.data, since, req.apiVersion());
     rsp.httpStatus = HttpStatusOk;
     return REQ_READY_SEND;
 }
 
+/*! Serializes the config, lights and groups which were changed after the
+    generation \p since as JSON object.
+
+    If the change log doesn't reach back to \p since, e.g. \p since is 0 or
+    from another gateway run, the full state is serialized and "full" is set to true.
+    \param data - the JSON object will be appended here
+    \param since - the generation known by the client
+    \param apiVersion - the API version requested by the client
+ */
+void DeRestPluginPrivate::changesToJson(QByteArray &data, quint64 since, ApiVersion apiVersion)
+{
+    JsonWriter json(data);
+
+    if ((since < changeLogTrimmed) || (since > gwGeneration))
+    {
+        const QByteArray &snapshot = fullStateSnapshot(apiVersion);
+        QDateTime datetime = QDateTime::currentDateTime();
+
+        data.reserve(data.size() + snapshot.size() + 128);
+        json.beginObject();
+        json.key("full");
+        json.value(true);
+        json.key("generation");
+        json.value(gwGeneration);
+        json.key("config");
+        json.beginObject();
+        json.key("utc");
+        json.value(datetime.toString("yyyy-MM-ddTHH:mm:ss")); // ISO 8601
+        data.append(snapshot);
+        return;
+    }
+
+    bool configChanged = false;
+    QSet<QString> lightIds;
+    QSet<QString> groupIds;
+
+    std::deque<ResourceChange>::const_reverse_iterator i = changeLog.rbegin();
+    std::deque<ResourceChange>::const_reverse_iterator end = changeLog.rend();
+
+    for (; (i != end) && (i->version > since); ++i)
+    {
+        switch (i->type)
+        {
+        case ResourceChange::TypeConfig: configChanged = true; break;
+        case ResourceChange::TypeLight: lightIds.insert(i->id); break;
+        case ResourceChange::TypeGroup: groupIds.insert(i->id); break;
+        default:
+            break;
+        }
+    }
+
+    json.beginObject();
+    json.key("full");
+    json.value(false);
+    json.key("generation");
+    json.value(gwGeneration);
+
+    if (configChanged)
+    {
+        QVariantMap config;
+        configToMap(config);
+        json.key("config");
+        json.value(config);
+    }
+
+    json.key("groups");
+    json.beginObject();
+    {
+        QSet<QString>::const_iterator i = groupIds.constBegin();
+        QSet<QString>::const_iterator end = groupIds.constEnd();
+
+        for (; i != end; ++i)
+        {
+            if (*i == "0")
+            {
+                continue; // not listed in full state either
+            }
+
+            Group *group = getGroupForId(*i);
+            json.key(*i);
+
+            if (group && (group->state() != Group::StateDeleted))
+            {
+                json.raw(groupToJson(group));
+            }
+            else
+            {
+                json.null();
+            }
+        }
+    }
+    json.endObject();
+
+    json.key("lights");
+    json.beginObject();
+    {
+        QSet<QString>::const_iterator i = lightIds.constBegin();
+        QSet<QString>::const_iterator end = lightIds.constEnd();
+
+        for (; i != end; ++i)
+        {
+            LightNode *lightNode = getLightNodeForId(*i);
+
+            json.key(*i);
+
+            if (lightNode)
+            {
+                json.raw(lightToJson(apiVersion, lightNode));
+            }
+            else
+            {
+                json.null();
+            }
+        }
+    }
+    json.endObject();
+    json.endObject();
+}
+
 /*! GET /api/<apikey>/config
     \return REQ_READY_SEND
             REQ_NOT_HANDLED
@@ -610,6 +776,11 @@ int DeRestPluginPrivate::modifyConfig(const ApiRequest &req, ApiResponse &rsp)
         {
             gwOtauActive = otauActive;
             changed = true;
+
+            if (gwOtauActive)
+            {
+                scheduleJob(JobOtau, HOUSEKEEPING_TICK);
+            }
         }
 
         QVariantMap rspItem;
@@ -688,7 +859,7 @@ int DeRestPluginPrivate::modifyConfig(const ApiRequest &req, ApiResponse &rsp)
 
     if (changed)
     {
-        updateEtag(gwConfigEtag);
+        updateConfigEtag();
     }
 
     rsp.etag = gwConfigEtag;
@@ -959,7 +1130,7 @@ void DeRestPluginPrivate::lockGatewayTimerFired()
     if (gwLinkButton)
     {
         gwLinkButton = false;
-        updateEtag(gwConfigEtag);
+        updateConfigEtag();
         DBG_Printf(DBG_INFO, "gateway locked\n");
     }
 }
@@ -976,7 +1147,7 @@ void DeRestPluginPrivate::checkRfConnectState()
             if (!gwRfConnected)
             {
                 gwRfConnected = true;
-                updateEtag(gwConfigEtag);
+                updateConfigEtag();
             }
         }
         else
@@ -986,7 +1157,7 @@ void DeRestPluginPrivate::checkRfConnectState()
             if (connected != gwRfConnected)
             {
                 gwRfConnected = connected;
-                updateEtag(gwConfigEtag);
+                updateConfigEtag();
             }
         }
 
@@ -1033,7 +1204,7 @@ void DeRestPluginPrivate::queryFirmwareVersionTimerFired()
 
                         if (gwFirmwareNeedUpdate)
                         {
-                            updateEtag(gwConfigEtag);
+                            updateConfigEtag();
                         }
                     }
                 }
@@ -1059,7 +1230,7 @@ void DeRestPluginPrivate::queryFirmwareVersionTimerFired()
                 } // for equal firmware or newer versions don't do anything
             }
 
-            updateEtag(gwConfigEtag);
+            updateConfigEtag();
             DBG_Printf(DBG_INFO, "GW firmware version: %s\n", qPrintable(gwFirmwareVersion));
         }
     }
@@ -0,0 +1,184 @@
+/*
+ * Copyright (C) 2013 dresden elektronik ingenieurtechnik gmbh.
+ * All rights reserved.
+ *
+ * The software in this package is published under the terms of the BSD
+ * style license a copy of which has been included with this distribution in
+ * the LICENSE.txt file.
+ *
+ */
+
+#include <QString>
+#include <QTcpSocket>
+#include <QHttpRequestHeader>
+#include <QHostAddress>
+#include "de_web_plugin.h"
+#include "de_web_plugin_private.h"
+#include "json.h"
+
+/*! GET /api/<apikey>/events
+
+    Opens a server-sent events stream (text/event-stream) which stays open
+    until the client disconnects. Each event holds the changes of one event
+    loop iteration in the format of GET /api/<apikey>/changes, the event id
+    is the generation.
+
+    A client which reconnects with a Last-Event-ID header gets the changes
+    it missed, otherwise the stream starts with the full state.
+
+    The response has no Content-Length, the stream ends when the connection
+    is closed, so it is sent with "Connection: close" and no further
+    requests are read from the socket. Each event is framed as
+
+        id: <generation>\n
+        data: <compact JSON object of the changes>\n
+        \n
+
+    The JSON contains no line breaks, an empty line terminates the event.
+    \return REQ_DONE
+ */
+int DeRestPluginPrivate::getEvents(const ApiRequest &req, ApiResponse &rsp)
+{
+    Q_UNUSED(rsp);
+
+    bool ok = false;
+    quint64 since = 0;
+
+    if (req.hdr.hasKey("Last-Event-ID"))
+    {
+        since = req.hdr.value("Last-Event-ID").toULongLong(&ok);
+    }
+
+    if (eventListeners.empty())
+    {
+        eventGeneration = gwGeneration; // nothing pending yet
+    }
+
+    QByteArray rspData;
+    rspData.append("HTTP/1.1 ").append(HttpStatusOk).append("\r\n");
+    rspData.append("Content-Type: ").append(HttpContentEventStream).append("\r\n");
+    rspData.append("Cache-Control: no-cache\r\n");
+    rspData.append("Access-Control-Allow-Origin: *\r\n");
+    rspData.append("Connection: close\r\n");
+    rspData.append("\r\n");
+
+    if (!ok || (since != gwGeneration))
+    {
+        appendEvent(rspData, since, req.apiVersion());
+    }
+
+    req.sock->write(rspData);
+    req.sock->flush();
+
+    // the keep-alive timeout doesn't apply to the stream
+    pushClientForClose(req.sock, -1);
+
+    EventListener listener;
+    listener.sock = req.sock;
+    listener.apiVersion = req.apiVersion();
+    eventListeners.push_back(listener);
+
+    DBG_Printf(DBG_HTTP, "HTTP event listener %s:%u added\n", qPrintable(req.sock->peerAddress().toString()), req.sock->peerPort());
+
+    return REQ_DONE;
+}
+
+/*! Appends a server-sent event with the changes after generation \p since.
+    \param data - the event will be appended here
+    \param since - the generation known by the client
+    \param apiVersion - the API version requested by the client
+ */
+void DeRestPluginPrivate::appendEvent(QByteArray &data, quint64 since, ApiVersion apiVersion)
+{
+    // the compact JSON contains no line breaks, so it fits into one data field
+    data.append("id: ").append(QByteArray::number(gwGeneration)).append('\n');
+    data.append("data: ");
+    changesToJson(data, since, apiVersion);
+    data.append("\n\n");
+}
+
+/*! Removes a client from the event listeners.
+    \param sock - the client socket
+ */
+void DeRestPluginPrivate::removeEventListener(QTcpSocket *sock)
+{
+    std::list<EventListener>::iterator i = eventListeners.begin();
+    std::list<EventListener>::iterator end = eventListeners.end();
+
+    for (; i != end; ++i)
+    {
+        if (i->sock == sock)
+        {
+            eventListeners.erase(i);
+            return;
+        }
+    }
+}
+
+/*! Returns true if \p sock carries an event stream.
+    \param sock - the client socket
+ */
+bool DeRestPluginPrivate::isEventListener(QTcpSocket *sock) const
+{
+    std::list<EventListener>::const_iterator i = eventListeners.begin();
+    std::list<EventListener>::const_iterator end = eventListeners.end();
+
+    for (; i != end; ++i)
+    {
+        if (i->sock == sock)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/*! Pushes the changes since the last event to all event listeners.
+    The event is rendered once per API version, clients which don't
+    consume their stream fast enough are dropped.
+ */
+void DeRestPluginPrivate::pushEventsTimerFired()
+{
+    eventPushPending = false;
+
+    if (eventGeneration == gwGeneration)
+    {
+        return;
+    }
+
+    QByteArray event;
+    QByteArray eventDdel;
+
+    std::list<EventListener>::iterator i = eventListeners.begin();
+    std::list<EventListener>::iterator end = eventListeners.end();
+
+    while (i != end)
+    {
+        QTcpSocket *sock = i->sock;
+
+        if ((sock->state() != QTcpSocket::ConnectedState) ||
+            (sock->bytesToWrite() > EVENT_MAX_PENDING_BYTES))
+        {
+            DBG_Printf(DBG_HTTP, "HTTP event listener %s:%u dropped\n", qPrintable(sock->peerAddress().toString()), sock->peerPort());
+            i = eventListeners.erase(i);
+            // the client may reconnect and resume with Last-Event-ID
+            sock->close();
+            sock->deleteLater();
+            continue;
+        }
+
+        QByteArray &data = (i->apiVersion == ApiVersion_1_DDEL) ? eventDdel : event;
+
+        if (data.isEmpty())
+        {
+            appendEvent(data, eventGeneration, i->apiVersion);
+        }
+
+        sock->write(data);
+        sock->flush();
+        ++i;
+    }
+
+    eventGeneration = gwGeneration;
+}
@@ -17,93 +17,6 @@
 #include "de_web_plugin_private.h"
 #include "json.h"
 
-/*! Groups and scenes REST API broker.
-    \param req - request data
-    \param rsp - response data
-    \return REQ_READY_SEND
-            REQ_NOT_HANDLED
- */
-int DeRestPluginPrivate::handleGroupsApi(ApiRequest &req, ApiResponse &rsp)
-{
-    if (req.path[2] != "groups")
-    {
-        return REQ_NOT_HANDLED;
-    }
-
-    if(!checkApikeyAuthentification(req, rsp))
-    {
-        return REQ_READY_SEND;
-    }
-
-    // GET /api/<apikey>/groups
-    if ((req.path.size() == 3) && (req.hdr.method() == "GET"))
-    {
-        return getAllGroups(req, rsp);
-    }
-    // POST /api/<apikey>/groups
-    else if ((req.path.size() == 3) && (req.hdr.method() == "POST"))
-    {
-        return createGroup(req, rsp);
-    }
-    // GET /api/<apikey>/groups/<id>
-    else if ((req.path.size() == 4) && (req.hdr.method() == "GET"))
-    {
-        return getGroupAttributes(req, rsp);
-    }
-    // PUT /api/<apikey>/groups/<id>
-    else if ((req.path.size() == 4) && (req.hdr.method() == "PUT"))
-    {
-        return setGroupAttributes(req, rsp);
-    }
-    // PUT /api/<apikey>/groups/<id>/action
-    else if ((req.path.size() == 5) && (req.hdr.method() == "PUT") && (req.path[4] == "action"))
-    {
-        return setGroupState(req, rsp);
-    }
-    // DELETE /api/<apikey>/groups/<id>
-    else if ((req.path.size() == 4) && (req.hdr.method() == "DELETE"))
-    {
-        return deleteGroup(req, rsp);
-    }
-    // POST /api/<apikey>/groups/<group_id>/scenes
-    else if ((req.path.size() == 5) && (req.hdr.method() == "POST")  && (req.path[4] == "scenes"))
-    {
-        return createScene(req, rsp);
-    }
-    // GET /api/<apikey>/groups/<group_id>/scenes
-    else if ((req.path.size() == 5) && (req.hdr.method() == "GET")  && (req.path[4] == "scenes"))
-    {
-        return getAllScenes(req, rsp);
-    }
-    // GET /api/<apikey>/groups/<group_id>/scenes/<scene_id>
-    else if ((req.path.size() == 6) && (req.hdr.method() == "GET")  && (req.path[4] == "scenes"))
-    {
-        return getSceneAttributes(req, rsp);
-    }
-    // PUT /api/<apikey>/groups/<group_id>/scenes/<scene_id>
-    else if ((req.path.size() == 6) && (req.hdr.method() == "PUT")  && (req.path[4] == "scenes"))
-    {
-        return setSceneAttributes(req, rsp);
-    }
-    // PUT /api/<apikey>/groups/<group_id>/scenes/<scene_id>/store
-    else if ((req.path.size() == 7) && (req.hdr.method() == "PUT")  && (req.path[4] == "scenes") && (req.path[6] == "store"))
-    {
-        return storeScene(req, rsp);
-    }
-    // PUT /api/<apikey>/groups/<group_id>/scenes/<scene_id>/recall
-    else if ((req.path.size() == 7) && (req.hdr.method() == "PUT")  && (req.path[4] == "scenes") && (req.path[6] == "recall"))
-    {
-        return recallScene(req, rsp);
-    }
-    // DELETE /api/<apikey>/groups/<group_id>/scenes/<scene_id>
-    else if ((req.path.size() == 6) && (req.hdr.method() == "DELETE")  && (req.path[4] == "scenes"))
-    {
-        return deleteScene(req, rsp);
-    }
-
-    return REQ_NOT_HANDLED;
-}
-
 /*! GET /api/<apikey>/groups
     \return REQ_READY_SEND
             REQ_NOT_HANDLED
@@ -113,9 +26,13 @@ int DeRestPluginPrivate::getAllGroups(const ApiRequest &req, ApiResponse &rsp)
     Q_UNUSED(req);
     rsp.httpStatus = HttpStatusOk;
 
+    JsonWriter json(rsp.data);
     std::vector<Group>::const_iterator i = groups.begin();
     std::vector<Group>::const_iterator end = groups.end();
 
+    rsp.data.reserve(groups.size() * 64);
+    json.beginObject();
+
     for (; i != end; ++i)
     {
         // ignore deleted groups
@@ -126,20 +43,20 @@ int DeRestPluginPrivate::getAllGroups(const ApiRequest &req, ApiResponse &rsp)
 
         if (i->address() != 0) // don't return special group 0
         {
-            QVariantMap mnode;
-
-            mnode["name"] = i->name();
             QString etag = i->etag;
             etag.remove('"'); // no quotes allowed in string
-            mnode["etag"] = etag;
-            rsp.map[i->id()] = mnode;
+
+            json.key(i->id());
+            json.beginObject();
+            json.key("etag");
+            json.value(etag);
+            json.key("name");
+            json.value(i->name());
+            json.endObject();
         }
     }
 
-    if (rsp.map.isEmpty())
-    {
-        rsp.str = "{}"; // return empty object
-    }
+    json.endObject(); // empty object if there are no groups
 
     return REQ_READY_SEND;
 }
@@ -228,8 +145,7 @@ int DeRestPluginPrivate::createGroup(const ApiRequest &req, ApiResponse &rsp)
             group.hue = 0;
             group.hueReal = 0.0f;
             group.sat = 128;
-            updateEtag(group.etag);
-            updateEtag(gwConfigEtag);
+            updateGroupEtag(&group);
             groups.push_back(group);
             queSaveDb(DB_GROUPS, DB_SHORT_SAVE_DELAY);
 
@@ -284,82 +200,20 @@ int DeRestPluginPrivate::getGroupAttributes(const ApiRequest &req, ApiResponse &
         }
     }
 
-    QVariantMap action;
-    QVariantList scenes;
-
-    action["on"] = group->isOn();
-    action["hue"] = (double)((uint16_t)(group->hueReal * 65535));
-    action["effect"] = "none"; // TODO
-    action["bri"] = (double)group->level;
-    action["sat"] = (double)group->sat;
-    action["ct"] = (double)500; // TODO
-    QVariantList xy;
-
-    // sanity for colorX
-    if (group->colorX > 65279)
-    {
-        group->colorX = 65279;
-    }
-    // sanity for colorY
-    if (group->colorY > 65279)
-    {
-        group->colorY = 65279;
-    }
-    double x = (double)group->colorX / 65279.0f; // normalize 0 .. 65279 to 0 .. 1
-    double y = (double)group->colorY / 65279.0f; // normalize 0 .. 65279 to 0 .. 1
-    xy.append(x);
-    xy.append(y);
-    action["xy"] = xy;
-
-    rsp.map["id"] = group->id();
-    rsp.map["name"] = group->name();
-    QString etag = group->etag;
-    etag.remove('"'); // no quotes allowed in string
-    rsp.map["etag"] = etag;
-    rsp.map["action"] = action;
-
-    // append lights which are known members in this group
-    QVariantList lights;
-    std::vector<LightNode>::const_iterator i = nodes.begin();
-    std::vector<LightNode>::const_iterator end = nodes.end();
-
-    for (; i != end; ++i)
-    {
-        std::vector<GroupInfo>::const_iterator ii = i->groups().begin();
-        std::vector<GroupInfo>::const_iterator eend = i->groups().end();
-
-        for (; ii != eend; ++ii)
-        {
-            if (ii->id == group->address())
-            {
-                if (ii->state == GroupInfo::StateInGroup)
-                {
-                    lights.append(i->id());
-                }
-                break;
-            }
-        }
-    }
-
-    rsp.map["lights"] = lights;
-
-    std::vector<Scene>::const_iterator si = group->scenes.begin();
-    std::vector<Scene>::const_iterator send = group->scenes.end();
+    // same as in the full state with additional id
+    const QByteArray &data = groupToJson(group);
 
-    for ( ;si != send; ++si)
-    {
-        if (si->state != Scene::StateDeleted)
-        {
-            QVariantMap scene;
-            QString sid = QString::number(si->id);
-            scene["id"] = sid;
-            scene["name"] = si->name;
+    DBG_Assert(data.startsWith('{'));
 
-            scenes.append(scene);
-        }
-    }
+    JsonWriter json(rsp.data);
 
-    rsp.map["scenes"] = scenes;
+    rsp.data.reserve(data.size() + 32);
+    json.beginObject();
+    json.key("id");
+    json.value(group->id());
+    rsp.data.append(',');
+    rsp.data.append(data.constData() + 1, data.size() - 1); // skip opening brace
+    rsp.etag = group->etag;
 
     return REQ_READY_SEND;
 }
@@ -471,6 +325,7 @@ int DeRestPluginPrivate::setGroupAttributes(const ApiRequest &req, ApiResponse &
                         groupInfo->actions &= ~GroupInfo::ActionRemoveFromGroup; // sanity
                         groupInfo->actions |= GroupInfo::ActionAddToGroup;
                         groupInfo->state = GroupInfo::StateInGroup;
+                        groupMembersDirty = true;
                     }
                 }
                 else
@@ -516,6 +371,7 @@ int DeRestPluginPrivate::setGroupAttributes(const ApiRequest &req, ApiResponse &
                         k->actions &= ~GroupInfo::ActionAddToGroup; // sanity
                         k->actions |= GroupInfo::ActionRemoveFromGroup;
                         k->state = GroupInfo::StateNotInGroup;
+                        groupMembersDirty = true;
                         changed = true;
                     }
                 }
@@ -525,8 +381,7 @@ int DeRestPluginPrivate::setGroupAttributes(const ApiRequest &req, ApiResponse &
 
     if (changed)
     {
-        updateEtag(group->etag);
-        updateEtag(gwConfigEtag);
+        updateGroupEtag(group);
     }
 
     rsp.etag = group->etag;
@@ -581,7 +436,7 @@ int DeRestPluginPrivate::setGroupState(const ApiRequest &req, ApiResponse &rsp)
     task.req.setSrcEndpoint(getSrcEndpoint(0, task.req));
 
     bool ok;
-    QVariant var = Json::parse(req.content, ok);
+    QVariant var = req.json(ok);
     QVariantMap map = var.toMap();
 
     if (!ok || map.isEmpty())
@@ -811,11 +666,13 @@ int DeRestPluginPrivate::setGroupState(const ApiRequest &req, ApiResponse &rsp)
         }
     }
 
-    updateEtag(group->etag);
-    updateEtag(gwConfigEtag);
+    updateGroupEtag(group);
     rsp.etag = group->etag;
 
-    processTasks();
+    if (!req.batch)
+    {
+        processTasks();
+    }
     // TODO: ct, alert, effect
 
     return REQ_READY_SEND;
@@ -868,34 +725,29 @@ int DeRestPluginPrivate::deleteGroup(const ApiRequest &req, ApiResponse &rsp)
             groupInfo->actions &= ~GroupInfo::ActionAddToGroup; // sanity
             groupInfo->actions |= GroupInfo::ActionRemoveFromGroup;
             groupInfo->state = GroupInfo::StateNotInGroup;
+            groupMembersDirty = true;
         }
     }
 
-    updateEtag(gwConfigEtag);
+    updateGroupEtag(group);
     rsp.httpStatus = HttpStatusOk;
 
     return REQ_READY_SEND;
 }
 
-/*! Put all parameters in a map for later json serialization.
-    \return true - on success
-            false - on error
+/*! Returns the serialized JSON representation of a group.
+    The data is only rendered if the version of the group has changed since
+    the last call.
  */
-bool DeRestPluginPrivate::groupToMap(const Group *group, QVariantMap &map)
+const QByteArray &DeRestPluginPrivate::groupToJson(Group *group)
 {
-    if (!group)
+    if (group->jsonCache.isValid(group->version, 0))
     {
-        return false;
+        return group->jsonCache.data();
     }
 
-    QVariantMap action;
-    action["hue"] = (double)((uint16_t)(group->hueReal * 65535));
-    action["on"] = group->isOn();
-    action["effect"] = "none"; // TODO
-    action["bri"] = (double)group->level;
-    action["sat"] = (double)group->sat;
-    action["ct"] = (double)500; // TODO
-    QVariantList xy;
+    QByteArray data;
+    JsonWriter json(data);
     uint16_t colorX = group->colorX;
     uint16_t colorY = group->colorY;
     // sanity for colorX
@@ -910,18 +762,40 @@ bool DeRestPluginPrivate::groupToMap(const Group *group, QVariantMap &map)
     }
     double x = (double)colorX / 65279.0f; // normalize 0 .. 65279 to 0 .. 1
     double y = (double)colorY / 65279.0f; // normalize 0 .. 65279 to 0 .. 1
-    xy.append(x);
-    xy.append(y);
-    action["xy"] = xy;
-    action["colormode"] = "hs"; // TODO
-    map["action"] = action;
-    map["name"] = group->name();
     QString etag = group->etag;
     etag.remove('"'); // no quotes allowed in string
-    map["etag"] = etag;
+
+    data.reserve(256);
+    json.beginObject();
+    json.key("action");
+    json.beginObject();
+    json.key("bri");
+    json.value((uint)group->level);
+    json.key("colormode");
+    json.value("hs"); // TODO
+    json.key("ct");
+    json.value(500); // TODO
+    json.key("effect");
+    json.value("none"); // TODO
+    json.key("hue");
+    json.value((uint)((uint16_t)(group->hueReal * 65535)));
+    json.key("on");
+    json.value(group->isOn());
+    json.key("sat");
+    json.value((uint)group->sat);
+    json.key("xy");
+    json.beginArray();
+    json.value(x);
+    json.value(y);
+    json.endArray();
+    json.endObject();
+
+    json.key("etag");
+    json.value(etag);
 
     // append lights which are known members in this group
-    QVariantList lights;
+    json.key("lights");
+    json.beginArray();
     std::vector<LightNode>::const_iterator i = nodes.begin();
     std::vector<LightNode>::const_iterator end = nodes.end();
 
@@ -936,16 +810,19 @@ bool DeRestPluginPrivate::groupToMap(const Group *group, QVariantMap &map)
             {
                 if (ii->state == GroupInfo::StateInGroup)
                 {
-                    lights.append(i->id());
+                    json.value(i->id());
                 }
                 break;
             }
         }
     }
+    json.endArray();
 
-    map["lights"] = lights;
+    json.key("name");
+    json.value(group->name());
 
-    QVariantList scenes;
+    json.key("scenes");
+    json.beginArray();
     std::vector<Scene>::const_iterator si = group->scenes.begin();
     std::vector<Scene>::const_iterator send = group->scenes.end();
 
@@ -953,18 +830,19 @@ bool DeRestPluginPrivate::groupToMap(const Group *group, QVariantMap &map)
     {
         if (si->state != Scene::StateDeleted)
         {
-            QVariantMap scene;
-            QString sid = QString::number(si->id);
-            scene["id"] = sid;
-            scene["name"] = si->name;
-
-            scenes.append(scene);
+            json.beginObject();
+            json.key("id");
+            json.value(QString::number(si->id));
+            json.key("name");
+            json.value(si->name);
+            json.endObject();
         }
     }
+    json.endArray();
+    json.endObject();
 
-    map["scenes"] = scenes;
-
-    return true;
+    group->jsonCache.setData(group->version, 0, data);
+    return group->jsonCache.data();
 }
 
 /*! POST /api/<apikey>/groups/<group_id>/scenes
@@ -1072,8 +950,7 @@ int DeRestPluginPrivate::createScene(const ApiRequest &req, ApiResponse &rsp)
         scene.name.sprintf("Scene %u", scene.id);
     }
     group->scenes.push_back(scene);
-    updateEtag(group->etag);
-    updateEtag(gwConfigEtag);
+    updateGroupEtag(group);
     queSaveDb(DB_SCENES, DB_SHORT_SAVE_DELAY);
 
     if (!storeScene(group, scene.id))
@@ -1234,8 +1111,7 @@ int DeRestPluginPrivate::setSceneAttributes(const ApiRequest &req, ApiResponse &
                     if (i->name != name)
                     {
                         i->name = name;
-                        updateEtag(group->etag);
-                        updateEtag(gwConfigEtag);
+                        updateGroupEtag(group);
                         queSaveDb(DB_SCENES, DB_SHORT_SAVE_DELAY);
                     }
 
@@ -1411,7 +1287,7 @@ int DeRestPluginPrivate::recallScene(const ApiRequest &req, ApiResponse &rsp)
                 if (!i->isOn())
                 {
                     i->setIsOn(true);
-                    updateEtag(i->etag);
+                    updateLightEtag(&(*i));
                 }
             }
         }
@@ -1421,11 +1297,9 @@ int DeRestPluginPrivate::recallScene(const ApiRequest &req, ApiResponse &rsp)
     if (!group->isOn())
     {
         group->setIsOn(true);
-        updateEtag(group->etag);
+        updateGroupEtag(group);
     }
 
-    updateEtag(gwConfigEtag);
-
     rspItemState["id"] = QString::number(scene.id);
     rspItem["success"] = rspItemState;
     rsp.list.append(rspItem);
@@ -1502,8 +1376,7 @@ int DeRestPluginPrivate::deleteScene(const ApiRequest &req, ApiResponse &rsp)
         return REQ_READY_SEND;
     }
 
-    updateEtag(group->etag);
-    updateEtag(gwConfigEtag);
+    updateGroupEtag(group);
     queSaveDb(DB_SCENES, DB_SHORT_SAVE_DELAY);
 
     rspItemState["id"] = QString::number(scene.id);
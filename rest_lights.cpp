@@ -17,64 +17,6 @@
 #include "de_web_plugin_private.h"
 #include "json.h"
 
-/*! Lights REST API broker.
-    \param req - request data
-    \param rsp - response data
-    \return REQ_READY_SEND
-            REQ_NOT_HANDLED
- */
-int DeRestPluginPrivate::handleLightsApi(ApiRequest &req, ApiResponse &rsp)
-{
-    if (req.path[2] != "lights")
-    {
-        return REQ_NOT_HANDLED;
-    }
-
-    if(!checkApikeyAuthentification(req, rsp))
-    {
-        return REQ_READY_SEND;
-    }
-
-    // GET /api/<apikey>/lights
-    if ((req.path.size() == 3) && (req.hdr.method() == "GET"))
-    {
-        return getAllLights(req, rsp);
-    }
-    // POST /api/<apikey>/lights
-    else if ((req.path.size() == 3) && (req.hdr.method() == "POST"))
-    {
-        return searchLights(req, rsp);
-    }
-    // GET /api/<apikey>/lights/new
-    else if ((req.path.size() == 4) && (req.hdr.method() == "GET") && (req.path[3] == "new"))
-    {
-        return getNewLights(req, rsp);
-    }
-    // GET /api/<apikey>/lights/<id>
-    else if ((req.path.size() == 4) && (req.hdr.method() == "GET"))
-    {
-        return getLightState(req, rsp);
-    }
-    // PUT /api/<apikey>/lights/<id>/state
-    else if ((req.path.size() == 5) && (req.hdr.method() == "PUT") && (req.path[4] == "state"))
-    {
-        return setLightState(req, rsp);
-    }
-    // PUT /api/<apikey>/lights/<id> (rename)
-    else if ((req.path.size() == 4) && (req.hdr.method() == "PUT"))
-    {
-        return renameLight(req, rsp);
-    }
-    // PUT /api/<apikey>/lights/<id>/name (rename)
-    // same as above but this is that the hue app sends
-    else if ((req.path.size() == 5) && (req.hdr.method() == "PUT") && (req.path[4] == "name"))
-    {
-        return renameLight(req, rsp);
-    }
-
-    return REQ_NOT_HANDLED;
-}
-
 /*! GET /api/<apikey>/lights
     \return REQ_READY_SEND
             REQ_NOT_HANDLED
@@ -84,25 +26,29 @@ int DeRestPluginPrivate::getAllLights(const ApiRequest &req, ApiResponse &rsp)
     Q_UNUSED(req);
     rsp.httpStatus = HttpStatusOk;
 
+    JsonWriter json(rsp.data);
     std::vector<LightNode>::const_iterator i = nodes.begin();
     std::vector<LightNode>::const_iterator end = nodes.end();
 
+    rsp.data.reserve(nodes.size() * 64);
+    json.beginObject();
+
     for (; i != end; ++i)
     {
-        QVariantMap mnode;
-
-        mnode["name"] = i->name();
         QString etag = i->etag;
         etag.remove('"'); // no quotes allowed in string
-        mnode["etag"] = etag;
-        rsp.map[i->id()] = mnode;
-    }
 
-    if (rsp.map.isEmpty())
-    {
-        rsp.str = "{}"; // return empty object
+        json.key(i->id());
+        json.beginObject();
+        json.key("etag");
+        json.value(etag);
+        json.key("name");
+        json.value(i->name());
+        json.endObject();
     }
 
+    json.endObject(); // empty object if there are no lights
+
     return REQ_READY_SEND;
 }
 
@@ -148,26 +94,21 @@ int DeRestPluginPrivate::getNewLights(const ApiRequest &req, ApiResponse &rsp)
     return REQ_NOT_HANDLED; // TODO
 }
 
-/*! Put all parameters in a map for later json serialization.
-    \return true - on success
-            false - on error
+/*! Returns the serialized JSON representation of a light.
+    The data is only rendered if the version of the light has changed since
+    the last call.
+    \param apiVersion - the API version requested by the client
+    \param lightNode - the light
  */
-bool DeRestPluginPrivate::lightToMap(const ApiRequest &req, const LightNode *lightNode, QVariantMap &map)
+const QByteArray &DeRestPluginPrivate::lightToJson(ApiVersion apiVersion, LightNode *lightNode)
 {
-    if (!lightNode)
+    if (lightNode->jsonCache.isValid(lightNode->version, apiVersion))
     {
-        return false;
+        return lightNode->jsonCache.data();
     }
 
-    QVariantMap state;
-    state["hue"] = (double)lightNode->enhancedHue();
-    state["on"] = lightNode->isOn();
-    state["effect"] = "none"; // TODO
-    state["alert"] = "none"; // TODO
-    state["bri"] = (double)lightNode->level();
-    state["sat"] = (double)lightNode->saturation();
-    state["ct"] = (double)500; // TODO
-    QVariantList xy;
+    QByteArray data;
+    JsonWriter json(data);
     uint16_t colorX = lightNode->colorX();
     uint16_t colorY = lightNode->colorY();
     // sanity for colorX
@@ -182,44 +123,69 @@ bool DeRestPluginPrivate::lightToMap(const ApiRequest &req, const LightNode *lig
     }
     double x = (double)colorX / 65279.0f; // normalize 0 .. 65279 to 0 .. 1
     double y = (double)colorY / 65279.0f; // normalize 0 .. 65279 to 0 .. 1
-    xy.append(x);
-    xy.append(y);
-    state["xy"] = xy;
-    state["reachable"] = lightNode->isAvailable();
-    state["colormode"] = lightNode->colorMode();
-    map["type"] = lightNode->type();
-    map["name"] = lightNode->name();
-    map["modelid"] = lightNode->modelId(); // real model id
-    map["hascolor"] = lightNode->hasColor();
-
-    if ((req.apiVersion() == ApiVersion_1_DDEL) || (lightNode->manufacturerCode() != VENDOR_DDEL))
-    {
-        map["type"] = lightNode->type();
+    QString etag = lightNode->etag;
+    etag.remove('"'); // no quotes allowed in string
+
+    data.reserve(512);
+    json.beginObject();
+    json.key("etag");
+    json.value(etag);
+    json.key("hascolor");
+    json.value(lightNode->hasColor());
+    json.key("manufacturer");
+    json.value(lightNode->manufacturer());
+    json.key("modelid");
+    json.value(lightNode->modelId()); // real model id
+    json.key("name");
+    json.value(lightNode->name());
+    json.key("pointsymbol"); // dummy
+    json.beginObject();
+    json.endObject();
+
+    json.key("state");
+    json.beginObject();
+    json.key("alert");
+    json.value("none"); // TODO
+    json.key("bri");
+    json.value((uint)lightNode->level());
+    json.key("colormode");
+    json.value(lightNode->colorMode());
+    json.key("ct");
+    json.value(500); // TODO
+    json.key("effect");
+    json.value("none"); // TODO
+    json.key("hue");
+    json.value((uint)lightNode->enhancedHue());
+    json.key("on");
+    json.value(lightNode->isOn());
+    json.key("reachable");
+    json.value(lightNode->isAvailable());
+    json.key("sat");
+    json.value((uint)lightNode->saturation());
+    json.key("xy");
+    json.beginArray();
+    json.value(x);
+    json.value(y);
+    json.endArray();
+    json.endObject();
+
+    json.key("swversion");
+    json.value(lightNode->swBuildId());
+    json.key("type");
+    if ((apiVersion == ApiVersion_1_DDEL) || (lightNode->manufacturerCode() != VENDOR_DDEL))
+    {
+        json.value(lightNode->type());
     }
     else
     {
         // quirks mode to mimic Philips Hue
         // ... some apps wrongly think the light has no color otherwise
-        //map["modelid"] = "LCT001"; // a hue
-        map["type"] = "Extended color light";
+        json.value("Extended color light");
     }
-    map["swversion"] = lightNode->swBuildId();
-    map["manufacturer"] = lightNode->manufacturer();
-    QVariantMap pointsymbol;
-    map["pointsymbol"] = pointsymbol; // dummy
-    pointsymbol["1"] = QString("none");
-    pointsymbol["2"] = QString("none");
-    pointsymbol["3"] = QString("none");
-    pointsymbol["4"] = QString("none");
-    pointsymbol["5"] = QString("none");
-    pointsymbol["6"] = QString("none");
-    pointsymbol["7"] = QString("none");
-    pointsymbol["8"] = QString("none");
-    QString etag = lightNode->etag;
-    etag.remove('"'); // no quotes allowed in string
-    map["etag"] = etag;
-    map["state"] = state;
-    return true;
+    json.endObject();
+
+    lightNode->jsonCache.setData(lightNode->version, apiVersion, data);
+    return lightNode->jsonCache.data();
 }
 
 /*! GET /api/<apikey>/lights/<id>
@@ -281,6 +247,7 @@ int DeRestPluginPrivate::getLightState(const ApiRequest &req, ApiResponse &rsp)
             DBG_Printf(DBG_INFO, "Force read the attributes %s, for node %s\n", qPrintable(attrs), qPrintable(lightNode->address().toStringExt()));
             lightNode->setLastRead(idleTotalCounter);
             processReadAttributes(lightNode);
+            scheduleRead(lightNode, 0); // remaining reads
         }
     }
 
@@ -297,7 +264,7 @@ int DeRestPluginPrivate::getLightState(const ApiRequest &req, ApiResponse &rsp)
         }
     }
 
-    lightToMap(req, lightNode, rsp.map);
+    rsp.data = lightToJson(req.apiVersion(), lightNode);
     rsp.httpStatus = HttpStatusOk;
     rsp.etag = lightNode->etag;
 
@@ -342,7 +309,7 @@ int DeRestPluginPrivate::setLightState(const ApiRequest &req, ApiResponse &rsp)
     task.req.setDstAddressMode(deCONZ::ApsExtAddress);
 
     bool ok;
-    QVariant var = Json::parse(req.content, ok);
+    QVariant var = req.json(ok);
     QVariantMap map = var.toMap();
 
     if (!ok || map.isEmpty())
@@ -606,12 +573,14 @@ int DeRestPluginPrivate::setLightState(const ApiRequest &req, ApiResponse &rsp)
 
     if (task.lightNode)
     {
-        updateEtag(task.lightNode->etag);
-        updateEtag(gwConfigEtag);
+        updateLightEtag(task.lightNode);
         rsp.etag = task.lightNode->etag;
     }
 
-    processTasks();
+    if (!req.batch)
+    {
+        processTasks();
+    }
     // TODO ct, alert, effect
 
     return REQ_READY_SEND;
@@ -664,8 +633,7 @@ int DeRestPluginPrivate::renameLight(const ApiRequest &req, ApiResponse &rsp)
             if (lightNode->name() != name)
             {
                 lightNode->setName(name);
-                updateEtag(gwConfigEtag);
-                updateEtag(lightNode->etag);
+                updateLightEtag(lightNode);
                 queSaveDb(DB_LIGHTS, DB_SHORT_SAVE_DELAY);
             }
 
@@ -0,0 +1,240 @@
+/*
+ * Copyright (C) 2013 dresden elektronik ingenieurtechnik gmbh.
+ * All rights reserved.
+ *
+ * The software in this package is published under the terms of the BSD
+ * style license a copy of which has been included with this distribution in
+ * the LICENSE.txt file.
+ *
+ */
+
+#include <string.h>
+#include "rest_router.h"
+
+/*! Constructor.
+ */
+RestPath::RestPath() :
+    m_count(0)
+{
+}
+
+/*! Splits the path into segments.
+
+    The query string is ignored. Some clients send /api123 instead
+    of /api/123 which is corrected here.
+
+    \param path - the request path
+    \return true - on success
+            false - if the path has too many segments
+ */
+bool RestPath::parse(const QByteArray &path)
+{
+    m_data = path;
+    m_count = 0;
+
+    const char *begin = m_data.constData();
+    const char *end = begin + m_data.size();
+    const char *p = begin;
+
+    while (p != end && *p != '?')
+    {
+        if (*p == '/')
+        {
+            p++;
+            continue;
+        }
+
+        const char *start = p;
+
+        while (p != end && *p != '/' && *p != '?')
+        {
+            p++;
+        }
+
+        if (m_count == REST_MAX_SEGMENTS)
+        {
+            return false;
+        }
+
+        m_pos[m_count] = start - begin;
+        m_len[m_count] = p - start;
+        m_count++;
+    }
+
+    // some clients send /api123 instead of /api/123
+    if ((m_count > 0) && (m_count < REST_MAX_SEGMENTS) &&
+        (m_len[0] > 3) && (m_pos[0] == 1) && (strncmp(begin + 1, "api", 3) == 0))
+    {
+        for (int i = m_count; i > 1; i--)
+        {
+            m_pos[i] = m_pos[i - 1];
+            m_len[i] = m_len[i - 1];
+        }
+
+        m_pos[1] = m_pos[0] + 3;
+        m_len[1] = m_len[0] - 3;
+        m_len[0] = 3;
+        m_count++;
+    }
+
+    return true;
+}
+
+/*! Returns the number of segments.
+ */
+int RestPath::count() const
+{
+    return m_count;
+}
+
+/*! Returns true if segment \p index equals \p str.
+ */
+bool RestPath::isSegment(int index, const char *str, int length) const
+{
+    if ((index >= m_count) || (m_len[index] != length))
+    {
+        return false;
+    }
+
+    return memcmp(m_data.constData() + m_pos[index], str, length) == 0;
+}
+
+/*! Returns the percent-decoded segments as string list as used by ApiRequest.
+ */
+QStringList RestPath::toStringList() const
+{
+    QStringList ls;
+
+    for (int i = 0; i < m_count; i++)
+    {
+        QByteArray segment = QByteArray::fromRawData(m_data.constData() + m_pos[i], m_len[i]);
+
+        if (segment.contains('%'))
+        {
+            ls.append(QString::fromUtf8(QByteArray::fromPercentEncoding(segment)));
+        }
+        else
+        {
+            ls.append(QString::fromUtf8(segment.constData(), segment.size()));
+        }
+    }
+
+    return ls;
+}
+
+/*! Adds a route to the table.
+
+    Routes are matched in the order they were added, therefore routes
+    with literal segments must be added before routes with wildcards
+    at the same position.
+
+    \param method - HTTP method like GET or PUT
+    \param path - the path pattern, "*" matches any segment
+    \param handler - the request handler
+    \param flags - RestRoute::Flags
+ */
+void RestRouter::addRoute(const char *method, const char *path, RestHandler handler, int flags)
+{
+    RestRoute route;
+    QList<QByteArray> ls = QByteArray(path).split('/');
+
+    route.method = method;
+    route.handler = handler;
+    route.flags = flags;
+
+    QList<QByteArray>::const_iterator i = ls.begin();
+    QList<QByteArray>::const_iterator end = ls.end();
+
+    for (; i != end; ++i)
+    {
+        if (!i->isEmpty())
+        {
+            route.segments.push_back(*i);
+        }
+    }
+
+    if (route.segments.size() > REST_MAX_SEGMENTS)
+    {
+        return;
+    }
+
+    // remember resource names like lights, groups, ...
+    if ((route.segments.size() > 2) && (route.segments[2] != "*"))
+    {
+        std::vector<QByteArray>::const_iterator r = m_resources.begin();
+        std::vector<QByteArray>::const_iterator rend = m_resources.end();
+
+        for (; r != rend; ++r)
+        {
+            if (*r == route.segments[2])
+            {
+                break;
+            }
+        }
+
+        if (r == rend)
+        {
+            m_resources.push_back(route.segments[2]);
+        }
+    }
+
+    m_routes[route.segments.size()].push_back(route);
+}
+
+/*! Returns the route for method and path or 0 if no route matches.
+ */
+const RestRoute *RestRouter::match(const QString &method, const RestPath &path) const
+{
+    const std::vector<RestRoute> &routes = m_routes[path.count()];
+    std::vector<RestRoute>::const_iterator i = routes.begin();
+    std::vector<RestRoute>::const_iterator end = routes.end();
+
+    for (; i != end; ++i)
+    {
+        if (method != QLatin1String(i->method))
+        {
+            continue;
+        }
+
+        size_t n = 0;
+        for (; n < i->segments.size(); n++)
+        {
+            const QByteArray &seg = i->segments[n];
+
+            if (seg == "*")
+            {
+                continue;
+            }
+
+            if (!path.isSegment((int)n, seg.constData(), seg.size()))
+            {
+                break;
+            }
+        }
+
+        if (n == i->segments.size())
+        {
+            return &(*i);
+        }
+    }
+
+    return 0;
+}
+
+/*! Returns true if segment \p index of the path names a known resource.
+ */
+bool RestRouter::isResource(const RestPath &path, int index) const
+{
+    std::vector<QByteArray>::const_iterator i = m_resources.begin();
+    std::vector<QByteArray>::const_iterator end = m_resources.end();
+
+    for (; i != end; ++i)
+    {
+        if (path.isSegment(index, i->constData(), i->size()))
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
@@ -0,0 +1,84 @@
+/*
+ * Copyright (C) 2013 dresden elektronik ingenieurtechnik gmbh.
+ * All rights reserved.
+ *
+ * The software in this package is published under the terms of the BSD
+ * style license a copy of which has been included with this distribution in
+ * the LICENSE.txt file.
+ *
+ */
+
+#ifndef REST_ROUTER_H
+#define REST_ROUTER_H
+
+#include <vector>
+#include <QByteArray>
+#include <QString>
+#include <QStringList>
+
+#define REST_MAX_SEGMENTS 8
+
+class ApiRequest;
+struct ApiResponse;
+class DeRestPluginPrivate;
+
+typedef int (DeRestPluginPrivate::*RestHandler)(const ApiRequest &req, ApiResponse &rsp);
+
+/*! \class RestPath
+
+    Splits a request path into its segments in a single pass.
+    The segments are stored as offsets into the path data.
+ */
+class RestPath
+{
+public:
+    RestPath();
+    bool parse(const QByteArray &path);
+    int count() const;
+    bool isSegment(int index, const char *str, int length) const;
+    QStringList toStringList() const;
+
+private:
+    QByteArray m_data;
+    int m_count;
+    int m_pos[REST_MAX_SEGMENTS];
+    int m_len[REST_MAX_SEGMENTS];
+};
+
+/*! \class RestRoute
+
+    Entry of the REST API route table.
+ */
+class RestRoute
+{
+public:
+    enum Flags
+    {
+        NoFlags  = 0x00,
+        NeedAuth = 0x01 //!< apikey is checked before the handler is called
+    };
+
+    const char *method;
+    std::vector<QByteArray> segments; //!< "*" matches any segment
+    RestHandler handler;
+    int flags;
+};
+
+/*! \class RestRouter
+
+    Route table which is compiled at startup and maps
+    HTTP method and path to a request handler.
+ */
+class RestRouter
+{
+public:
+    void addRoute(const char *method, const char *path, RestHandler handler, int flags);
+    const RestRoute *match(const QString &method, const RestPath &path) const;
+    bool isResource(const RestPath &path, int index) const;
+
+private:
+    std::vector<RestRoute> m_routes[REST_MAX_SEGMENTS + 1]; // by segment count
+    std::vector<QByteArray> m_resources; // known resources like lights, groups, ...
+};
+
+#endif // REST_ROUTER_H
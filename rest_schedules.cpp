@@ -20,53 +20,10 @@
  */
 void DeRestPluginPrivate::initSchedules()
 {
-    scheduleTimer = new QTimer(this);
-    scheduleTimer->setSingleShot(false);
-    connect(scheduleTimer, SIGNAL(timeout()),
-            this, SLOT(scheduleTimerFired()));
-    scheduleTimer->start(SCHEDULE_CHECK_PERIOD);
-}
-
-/*! Schedules REST API broker.
-    \param req - request data
-    \param rsp - response data
-    \return REQ_READY_SEND
-            REQ_NOT_HANDLED
- */
-int DeRestPluginPrivate::handleSchedulesApi(ApiRequest &req, ApiResponse &rsp)
-{
-    if (req.path[2] != "schedules")
-    {
-        return REQ_NOT_HANDLED;
-    }
-
-    // GET /api/<apikey>/schedules
-    if ((req.path.size() == 3) && (req.hdr.method() == "GET"))
-    {
-        return getAllSchedules(req, rsp);
-    }
-    // POST /api/<apikey>/schedules
-    else if ((req.path.size() == 3) && (req.hdr.method() == "POST"))
-    {
-        return createSchedule(req, rsp);
-    }
-    // GET /api/<apikey>/schedules/<id>
-    else if ((req.path.size() == 4) && (req.hdr.method() == "GET"))
+    if (!schedules.empty())
     {
-        return getScheduleAttributes(req, rsp);
+        scheduleJob(JobSchedules, SCHEDULE_CHECK_PERIOD);
     }
-    // PUT /api/<apikey>/schedules/<id>
-    else if ((req.path.size() == 4) && (req.hdr.method() == "PUT"))
-    {
-        return setScheduleAttributes(req, rsp);
-    }
-    // DELETE /api/<apikey>/schedules/<id>
-    else if ((req.path.size() == 4) && (req.hdr.method() == "DELETE"))
-    {
-        return deleteSchedule(req, rsp);
-    }
-
-    return REQ_NOT_HANDLED;
 }
 
 /*! GET /api/<apikey>/schedules
@@ -217,6 +174,7 @@ int DeRestPluginPrivate::createSchedule(const ApiRequest &req, ApiResponse &rsp)
 
     // append schedule
     schedules.push_back(schedule);
+    scheduleJob(JobSchedules, SCHEDULE_CHECK_PERIOD);
 
     QVariantMap rspItem;
     QVariantMap rspItemState;
@@ -349,26 +307,26 @@ void DeRestPluginPrivate::scheduleTimerFired()
             }
 
             QHttpRequestHeader hdr(method, address);
-            QStringList path = hdr.path().split('/');
+            RestPath restPath;
+            restPath.parse(hdr.path().toLatin1());
+            QStringList path = restPath.toStringList();
 
-            // first element in list is empty because of spli('/'):
-            // [/][api] becomes [][api]
-            if (!path.isEmpty() && path[0].isEmpty())
-            {
-                path.removeFirst();
-            }
-
-            ApiRequest req(hdr, path, NULL, content);
+            ApiRequest req(hdr, path, NULL, content.toUtf8());
             ApiResponse rsp; // dummy
 
             DBG_Printf(DBG_INFO, "body: %s\n", qPrintable(content));
 
-            if (handleLightsApi(req, rsp) == REQ_NOT_HANDLED)
+            // only light and group requests are allowed
+            const RestRoute *route = 0;
+
+            if (restPath.isSegment(2, "lights", 6) || restPath.isSegment(2, "groups", 6))
+            {
+                route = router.match(method, restPath);
+            }
+
+            if (!route || (handleApiRequest(route, req, rsp) == REQ_NOT_HANDLED))
             {
-                if (handleGroupsApi(req, rsp) == REQ_NOT_HANDLED)
-                {
-                    DBG_Printf(DBG_INFO, "Schedule was neigher light nor group request.\n");
-                }
+                DBG_Printf(DBG_INFO, "Schedule was neigher light nor group request.\n");
             }
 
             return;
@@ -68,55 +68,13 @@ void DeRestPluginPrivate::initTouchlinkApi()
     touchlinkTimer = 0;
 }
 
-/*! Touchlink REST API broker.
-    \param req - request data
-    \param rsp - response data
-    \return REQ_READY_SEND
-            REQ_NOT_HANDLED
- */
-int DeRestPluginPrivate::handleTouchlinkApi(ApiRequest &req, ApiResponse &rsp)
-{
-    if (req.path[2] != "touchlink")
-    {
-        return REQ_NOT_HANDLED;
-    }
-
-    if(!checkApikeyAuthentification(req, rsp))
-    {
-        return REQ_READY_SEND;
-    }
-
-    // POST /api/<apikey>/touchlink/scan
-    if ((req.path.size() == 4) && (req.hdr.method() == "POST") && (req.path[3] == "scan"))
-    {
-        return touchlinkScan(req, rsp);
-    }
-    // GET /api/<apikey>/touchlink/scan
-    if ((req.path.size() == 4) && (req.hdr.method() == "GET") && (req.path[3] == "scan"))
-    {
-        return getTouchlinkScanResults(req, rsp);
-    }
-    // POST /api/<apikey>/touchlink/<id>/identify
-    if ((req.path.size() == 5) && (req.hdr.method() == "POST") && (req.path[4] == "identify"))
-    {
-        return identifyLight(req, rsp);
-    }
-    // POST /api/<apikey>/touchlink/<id>/reset
-    if ((req.path.size() == 5) && (req.hdr.method() == "POST") && (req.path[4] == "reset"))
-    {
-        return resetLight(req, rsp);
-    }
-
-    return REQ_NOT_HANDLED;
-}
-
 /*! POST /api/<apikey>/touchlink/scan
     \param req - request data
     \param rsp - response data
     \return REQ_READY_SEND
             REQ_NOT_HANDLED
  */
-int DeRestPluginPrivate::touchlinkScan(ApiRequest &req, ApiResponse &rsp)
+int DeRestPluginPrivate::touchlinkScan(const ApiRequest &req, ApiResponse &rsp)
 {
     Q_UNUSED(req);
 
@@ -153,7 +111,7 @@ int DeRestPluginPrivate::touchlinkScan(ApiRequest &req, ApiResponse &rsp)
     \return REQ_READY_SEND
             REQ_NOT_HANDLED
  */
-int DeRestPluginPrivate::getTouchlinkScanResults(ApiRequest &req, ApiResponse &rsp)
+int DeRestPluginPrivate::getTouchlinkScanResults(const ApiRequest &req, ApiResponse &rsp)
 {
     Q_UNUSED(req);
     rsp.httpStatus = HttpStatusOk;
@@ -203,7 +161,7 @@ int DeRestPluginPrivate::getTouchlinkScanResults(ApiRequest &req, ApiResponse &r
     \return REQ_READY_SEND
             REQ_NOT_HANDLED
  */
-int DeRestPluginPrivate::identifyLight(ApiRequest &req, ApiResponse &rsp)
+int DeRestPluginPrivate::identifyLight(const ApiRequest &req, ApiResponse &rsp)
 {
     /*
      * - disconnect
@@ -267,7 +225,7 @@ int DeRestPluginPrivate::identifyLight(ApiRequest &req, ApiResponse &rsp)
     \return REQ_READY_SEND
             REQ_NOT_HANDLED
  */
-int DeRestPluginPrivate::resetLight(ApiRequest &req, ApiResponse &rsp)
+int DeRestPluginPrivate::resetLight(const ApiRequest &req, ApiResponse &rsp)
 {
     /*
      * - disconnect
@@ -639,8 +597,7 @@ void DeRestPluginPrivate::sendTouchlinkConfirm(deCONZ::TouchlinkStatus status)
                 if (lightNode)
                 {
                     lightNode->setIsAvailable(false);
-                    updateEtag(lightNode->etag);
-                    updateEtag(gwConfigEtag);
+                    updateLightEtag(lightNode);
                 }
 
             }
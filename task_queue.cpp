@@ -0,0 +1,786 @@
+/*
+ * Copyright (C) 2013 dresden elektronik ingenieurtechnik gmbh.
+ * All rights reserved.
+ *
+ * The software in this package is published under the terms of the BSD
+ * style license a copy of which has been included with this distribution in
+ * the LICENSE.txt file.
+ *
+ */
+
+#include "de_web_plugin.h"
+#include "de_web_plugin_private.h"
+
+// keys of non ext addresses, the OUI ff:ff:ff is not assigned
+#define TASK_KEY_GROUP  0xFFFFFFFFFFFF0000ULL
+#define TASK_KEY_NWK    0xFFFFFFFFFFFE0000ULL
+
+/*! Returns the TASK_ATTR_* flags of the attributes which are set by \p task,
+    0 if the task doesn't set light attributes.
+ */
+uint TaskQueue::taskAttributes(const TaskItem &task)
+{
+    switch (task.taskType)
+    {
+    case TaskSetOnOff:
+        return TASK_ATTR_ON_OFF;
+
+    case TaskSetLevel:
+        if (task.zclFrame.commandId() == 0x04) // Move to level (with on/off)
+        {
+            return TASK_ATTR_LEVEL | TASK_ATTR_ON_OFF;
+        }
+        return TASK_ATTR_LEVEL;
+
+    case TaskSetHue:
+    case TaskSetEnhancedHue:
+        return TASK_ATTR_HUE;
+
+    case TaskSetSat:
+        return TASK_ATTR_SAT;
+
+    case TaskSetHueAndSaturation:
+    case TaskSetXyColor:
+        return TASK_ATTR_COLOR;
+
+    default:
+        break;
+    }
+
+    return 0;
+}
+
+/*! Constructor.
+ */
+TaskDestination::TaskDestination() :
+    head(-1),
+    tail(-1),
+    count(0),
+    busy(false),
+    ready(false),
+    parked(false)
+{
+}
+
+/*! Constructor.
+ */
+TaskQueue::TaskQueue() :
+    m_pool(TASK_POOL_SIZE),
+    m_next(TASK_POOL_SIZE, -1),
+    m_runningCount(0),
+    m_queued(0),
+    m_expired(0),
+    m_window(TASK_INITIAL_RUNNING),
+    m_srtt(0),
+    m_minRtt(0),
+    m_prevMinRtt(0),
+    m_minRttStart(0),
+    m_lastDecrease(0)
+{
+    m_free.reserve(TASK_POOL_SIZE);
+
+    for (int i = TASK_POOL_SIZE - 1; i >= 0; i--)
+    {
+        m_free.push_back(i);
+    }
+
+    for (int i = 0; i < 256; i++)
+    {
+        m_running[i].slot = -1;
+        m_running[i].sendTime = 0;
+    }
+
+    m_clock.start();
+}
+
+/*! Returns the key of the destination of \p req.
+ */
+quint64 TaskQueue::destinationKey(const deCONZ::ApsDataRequest &req)
+{
+    switch (req.dstAddressMode())
+    {
+    case deCONZ::ApsExtAddress:
+        return req.dstAddress().ext();
+
+    case deCONZ::ApsGroupAddress:
+        return TASK_KEY_GROUP | req.dstAddress().group();
+
+    default:
+        break;
+    }
+
+    return TASK_KEY_NWK | req.dstAddress().nwk();
+}
+
+/*! Adds a task to the queue of its destination.
+
+    Queued tasks which only set attributes that are also set by the newer
+    task are never sent, they are removed and the newer task is appended.
+    E.g. a slider which sends many brightness values results in one command
+    with the latest value. Since the newer task goes to the tail it still
+    runs after queued tasks it doesn't cover, like a scene recall.
+    Other tasks are replaced if type and layout are equal.
+    \return true - on success
+            false - if the queue is full
+ */
+bool TaskQueue::add(const TaskItem &task)
+{
+    quint64 key = destinationKey(task.req);
+    QHash<quint64, TaskDestination>::iterator d = m_destinations.find(key);
+    uint attributes = taskAttributes(task);
+
+    if ((d != m_destinations.end()) && (attributes != 0))
+    {
+        int prev = -1;
+        int slot = d->head;
+
+        while (slot != -1)
+        {
+            TaskItem &queuedTask = m_pool[slot];
+            uint queued = taskAttributes(queuedTask);
+            int next = m_next[slot];
+
+            if ((queued != 0) && ((queued & ~attributes) == 0) &&
+                (queuedTask.req.dstEndpoint() == task.req.dstEndpoint()) &&
+                (queuedTask.req.srcEndpoint() == task.req.srcEndpoint()) &&
+                (queuedTask.req.profileId() == task.req.profileId()))
+            {
+                DBG_Printf(DBG_INFO_L2, "Supersede queued task cluster 0x%04X with newer task\n", queuedTask.req.clusterId());
+
+                if (prev == -1)
+                {
+                    d->head = next;
+                }
+                else
+                {
+                    m_next[prev] = next;
+                }
+
+                if (d->tail == slot)
+                {
+                    d->tail = prev;
+                }
+
+                d->count--;
+                m_queued--;
+                freeSlot(slot);
+                slot = next;
+                continue;
+            }
+            prev = slot;
+            slot = next;
+        }
+    }
+    else if ((d != m_destinations.end()) &&
+             (task.taskType != TaskGetSceneMembership) &&
+             (task.taskType != TaskGetGroupMembership) &&
+             (task.taskType != TaskStoreScene) &&
+             (task.taskType != TaskRemoveScene) &&
+             (task.taskType != TaskReadAttributes) &&
+             (task.taskType != TaskBind) &&
+             (task.taskType != TaskConfigureReporting))
+    {
+        for (int slot = d->head; slot != -1; slot = m_next[slot])
+        {
+            TaskItem &queuedTask = m_pool[slot];
+
+            if (queuedTask.taskType == task.taskType)
+            {
+                if ((queuedTask.req.dstEndpoint() == task.req.dstEndpoint()) &&
+                    (queuedTask.req.srcEndpoint() == task.req.srcEndpoint()) &&
+                    (queuedTask.req.profileId() == task.req.profileId()) &&
+                    (queuedTask.req.clusterId() == task.req.clusterId()) &&
+                    (queuedTask.req.txOptions() == task.req.txOptions()) &&
+                    (queuedTask.req.asdu().size() == task.req.asdu().size()))
+
+                {
+                    DBG_Printf(DBG_INFO, "Replace task in queue cluster 0x%04X with newer task of same type\n", task.req.clusterId());
+                    queuedTask = task;
+                    return true;
+                }
+            }
+        }
+    }
+
+    if ((m_queued >= TASK_MAX_QUEUED) || m_free.empty())
+    {
+        return false;
+    }
+
+    if (d == m_destinations.end())
+    {
+        d = m_destinations.insert(key, TaskDestination());
+    }
+    else if (d->count >= TASK_MAX_PER_DESTINATION)
+    {
+        return false;
+    }
+
+    int slot = m_free.back();
+    m_free.pop_back();
+    m_pool[slot] = task;
+    m_next[slot] = -1;
+
+    if (d->tail == -1)
+    {
+        d->head = slot;
+    }
+    else
+    {
+        m_next[d->tail] = slot;
+    }
+    d->tail = slot;
+    d->count++;
+    m_queued++;
+
+    if (!d->busy && !d->ready && !d->parked)
+    {
+        d->ready = true;
+        m_ready.push_back(key);
+    }
+
+    return true;
+}
+
+/*! Takes the next idle destination with queued tasks from the ready list.
+    The caller must either start or drop the front task of the destination
+    or put it back with pushReady().
+    \param dst - will be set to the destination key
+    \return true - if a destination was found
+ */
+bool TaskQueue::popReady(quint64 *dst)
+{
+    while (!m_ready.empty())
+    {
+        quint64 key = m_ready.front();
+        m_ready.pop_front();
+
+        QHash<quint64, TaskDestination>::iterator d = m_destinations.find(key);
+
+        if ((d != m_destinations.end()) && d->ready)
+        {
+            d->ready = false;
+
+            if (!d->busy && (d->count > 0))
+            {
+                *dst = key;
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+/*! Puts a destination back at the end of the ready list.
+ */
+void TaskQueue::pushReady(quint64 dst)
+{
+    QHash<quint64, TaskDestination>::iterator d = m_destinations.find(dst);
+
+    if ((d != m_destinations.end()) && !d->busy && !d->ready && !d->parked && (d->count > 0))
+    {
+        d->ready = true;
+        m_ready.push_back(dst);
+    }
+}
+
+/*! Keeps a destination out of the ready list for \p delay ms.
+    \param dst - a destination taken by popReady()
+    \param delay - ms until the destination gets ready again
+ */
+void TaskQueue::park(quint64 dst, int delay)
+{
+    QHash<quint64, TaskDestination>::iterator d = m_destinations.find(dst);
+
+    if ((d != m_destinations.end()) && !d->ready && !d->parked)
+    {
+        d->parked = true;
+        m_parked.push(qMakePair(m_clock.elapsed() + delay, dst));
+    }
+}
+
+/*! Puts parked destinations whose deadline is reached back into the ready list.
+ */
+void TaskQueue::resumeParked()
+{
+    qint64 now = m_clock.elapsed();
+
+    while (!m_parked.empty() && (m_parked.top().first <= now))
+    {
+        quint64 key = m_parked.top().second;
+        m_parked.pop();
+
+        QHash<quint64, TaskDestination>::iterator d = m_destinations.find(key);
+
+        if ((d != m_destinations.end()) && d->parked)
+        {
+            d->parked = false;
+            release(key);
+        }
+    }
+}
+
+/*! Returns the ms until processing is needed again, i.e. a destination is
+    ready, a parked destination gets ready or a running task expires.
+    \return the delay in ms, 0 - now, -1 - nothing to wait for
+ */
+qint64 TaskQueue::nextWakeup()
+{
+    if (!m_ready.empty() && (m_runningCount < window()))
+    {
+        return 0;
+    }
+
+    qint64 next = -1;
+
+    if (!m_parked.empty())
+    {
+        next = m_parked.top().first;
+    }
+
+    // forget deadlines of tasks which are already confirmed
+    while (!m_deadlines.empty())
+    {
+        const QPair<uint8_t, qint64> &deadline = m_deadlines.front();
+        const RunningTask &running = m_running[deadline.first];
+
+        if ((running.slot != -1) && (running.sendTime == deadline.second))
+        {
+            qint64 expiry = deadline.second + TASK_CONFIRM_TIMEOUT;
+
+            if ((next < 0) || (expiry < next))
+            {
+                next = expiry;
+            }
+            break;
+        }
+
+        m_deadlines.pop_front();
+    }
+
+    if (next < 0)
+    {
+        return -1;
+    }
+
+    qint64 now = m_clock.elapsed();
+    return (next > now) ? (next - now) : 0;
+}
+
+/*! Returns the next task of a destination or 0 if there is none.
+ */
+TaskItem *TaskQueue::front(quint64 dst)
+{
+    QHash<quint64, TaskDestination>::iterator d = m_destinations.find(dst);
+
+    if ((d == m_destinations.end()) || (d->head == -1))
+    {
+        return 0;
+    }
+
+    return &m_pool[d->head];
+}
+
+/*! Collects the queued tasks of a destination in send order.
+    The tasks stay in the pool and may be inspected but must not be kept.
+    \param dst - the destination key
+    \param tasks - the tasks, empty if there are none
+ */
+void TaskQueue::queuedTasks(quint64 dst, std::vector<TaskItem*> &tasks)
+{
+    tasks.clear();
+
+    QHash<quint64, TaskDestination>::iterator d = m_destinations.find(dst);
+
+    if (d == m_destinations.end())
+    {
+        return;
+    }
+
+    for (int slot = d->head; slot != -1; slot = m_next[slot])
+    {
+        tasks.push_back(&m_pool[slot]);
+    }
+}
+
+/*! Collects the destinations of the ready list.
+    \param dsts - the keys of idle destinations with queued tasks
+ */
+void TaskQueue::readyDestinations(std::vector<quint64> &dsts) const
+{
+    dsts.clear();
+
+    std::deque<quint64>::const_iterator i = m_ready.begin();
+    std::deque<quint64>::const_iterator end = m_ready.end();
+
+    for (; i != end; ++i)
+    {
+        QHash<quint64, TaskDestination>::const_iterator d = m_destinations.find(*i);
+
+        if ((d != m_destinations.end()) && d->ready && !d->busy && (d->count > 0))
+        {
+            dsts.push_back(*i);
+        }
+    }
+}
+
+/*! Discards the next task of a destination.
+ */
+void TaskQueue::dropFront(quint64 dst)
+{
+    QHash<quint64, TaskDestination>::iterator d = m_destinations.find(dst);
+
+    if ((d != m_destinations.end()) && (d->head != -1))
+    {
+        freeSlot(popFront(d));
+        release(dst);
+    }
+}
+
+/*! Moves the next task of a destination to the running tasks.
+    The destination stays busy until the task is confirmed or expired.
+ */
+void TaskQueue::startFront(quint64 dst)
+{
+    QHash<quint64, TaskDestination>::iterator d = m_destinations.find(dst);
+
+    if ((d == m_destinations.end()) || (d->head == -1))
+    {
+        return;
+    }
+
+    uint8_t id = m_pool[d->head].req.id();
+
+    if (m_running[id].slot != -1)
+    {
+        // the 8-bit request id wrapped around, the old task won't be confirmed anymore
+        DBG_Printf(DBG_INFO, "Expire task with reused request id %u\n", id);
+        m_expired++;
+        finish(id);
+    }
+
+    // the task stays in its pool slot, only the index moves
+    RunningTask &running = m_running[id];
+    running.slot = popFront(d);
+    running.sendTime = m_clock.elapsed();
+    m_runningCount++;
+    m_deadlines.push_back(qMakePair(id, running.sendTime));
+
+    d->busy = true;
+}
+
+/*! Removes a running task after its APSDE-DATA.confirm.
+
+    The in-flight window grows while confirms are successful and the
+    latency stays near its minimum, it is halved on failures and
+    rising latency. Only APS acknowledged unicasts are measured, the
+    confirm of a groupcast comes without a round trip. The minimum is
+    taken over the last one to two TASK_RTT_MIN_PERIODs, so it follows
+    routes which became longer.
+    \param id - the APS request id
+    \param success - true if the confirm status is success
+    \return true - if the task was found
+ */
+bool TaskQueue::confirm(uint8_t id, bool success)
+{
+    const RunningTask &running = m_running[id];
+
+    if (running.slot == -1)
+    {
+        return false;
+    }
+
+    DBG_Printf(DBG_INFO_L2, "Erase task zclSequenceNumber: %u\n", m_pool[running.slot].zclFrame.sequenceNumber());
+    qint64 now = m_clock.elapsed();
+    qint64 rtt = now - running.sendTime;
+    bool acknowledged = (m_pool[running.slot].req.txOptions() & deCONZ::ApsTxAcknowledgedTransmission) != 0;
+    finish(id);
+
+    if (!success)
+    {
+        decreaseWindow("confirm failed");
+        return true;
+    }
+
+    if (!acknowledged)
+    {
+        return true;
+    }
+
+    if (m_srtt == 0)
+    {
+        m_srtt = rtt;
+    }
+    else
+    {
+        m_srtt += (rtt - m_srtt) / 8; // EWMA, gain 1/8
+    }
+
+    if ((now - m_minRttStart) >= TASK_RTT_MIN_PERIOD)
+    {
+        // start a new period, older minimums age out
+        m_prevMinRtt = m_minRtt;
+        m_minRtt = 0;
+        m_minRttStart = now;
+    }
+
+    if ((m_minRtt == 0) || (rtt < m_minRtt))
+    {
+        m_minRtt = rtt;
+    }
+
+    qint64 minRtt = m_minRtt;
+
+    if ((m_prevMinRtt != 0) && (m_prevMinRtt < minRtt))
+    {
+        minRtt = m_prevMinRtt;
+    }
+
+    if (m_srtt > ((2 * minRtt) + TASK_RTT_TOLERANCE))
+    {
+        decreaseWindow("latency");
+    }
+    else
+    {
+        increaseWindow();
+    }
+
+    return true;
+}
+
+/*! Removes running tasks which didn't get a confirm within TASK_CONFIRM_TIMEOUT.
+    Deadlines are checked in send order, so only expired entries are visited.
+    \return the number of expired tasks
+ */
+int TaskQueue::expire()
+{
+    int count = 0;
+    qint64 now = m_clock.elapsed();
+
+    while (!m_deadlines.empty())
+    {
+        const QPair<uint8_t, qint64> &deadline = m_deadlines.front();
+
+        if ((now - deadline.second) < TASK_CONFIRM_TIMEOUT)
+        {
+            break;
+        }
+
+        const RunningTask &running = m_running[deadline.first];
+
+        // the task might be confirmed already or the id reused by a newer task
+        if ((running.slot != -1) && (running.sendTime == deadline.second))
+        {
+            DBG_Printf(DBG_INFO, "Expire task %u without APSDE-DATA.confirm\n", deadline.first);
+            finish(deadline.first);
+            decreaseWindow("timeout");
+            m_expired++;
+            count++;
+        }
+
+        m_deadlines.pop_front();
+    }
+
+    return count;
+}
+
+/*! Removes a running task and frees its destination.
+    \param id - the APS request id of the task
+ */
+void TaskQueue::finish(uint8_t id)
+{
+    RunningTask &running = m_running[id];
+    quint64 key = destinationKey(m_pool[running.slot].req);
+    freeSlot(running.slot);
+    running.slot = -1;
+    m_runningCount--;
+
+    QHash<quint64, TaskDestination>::iterator d = m_destinations.find(key);
+
+    if (d != m_destinations.end())
+    {
+        d->busy = false;
+        release(key);
+    }
+}
+
+/*! Puts a destination back into the ready list if it has more tasks.
+    Idle destinations are kept, so steady traffic to the same devices
+    doesn't allocate hash nodes.
+ */
+void TaskQueue::release(quint64 dst)
+{
+    QHash<quint64, TaskDestination>::iterator d = m_destinations.find(dst);
+
+    if ((d == m_destinations.end()) || d->busy || d->parked)
+    {
+        return;
+    }
+
+    if ((d->count > 0) && !d->ready)
+    {
+        d->ready = true;
+        m_ready.push_back(dst);
+    }
+}
+
+/*! Unlinks the first queued task of a destination.
+    \return the pool index of the task
+ */
+int TaskQueue::popFront(QHash<quint64, TaskDestination>::iterator d)
+{
+    int slot = d->head;
+
+    d->head = m_next[slot];
+    if (d->head == -1)
+    {
+        d->tail = -1;
+    }
+    d->count--;
+    m_queued--;
+    m_next[slot] = -1;
+
+    return slot;
+}
+
+/*! Returns a pool slot to the free list.
+    The old task isn't destructed, its implicitly shared data is released
+    when the slot is assigned the next time.
+ */
+void TaskQueue::freeSlot(int slot)
+{
+    m_next[slot] = -1;
+    m_free.push_back(slot);
+}
+
+/*! Removes all queued and running tasks.
+ */
+void TaskQueue::clear()
+{
+    m_destinations.clear();
+    m_ready.clear();
+    m_deadlines.clear();
+    m_free.clear();
+
+    for (int i = TASK_POOL_SIZE - 1; i >= 0; i--)
+    {
+        m_next[i] = -1;
+        m_free.push_back(i);
+    }
+
+    for (int i = 0; i < 256; i++)
+    {
+        m_running[i].slot = -1;
+    }
+
+    m_runningCount = 0;
+    while (!m_parked.empty())
+    {
+        m_parked.pop();
+    }
+    m_queued = 0;
+}
+
+/*! Returns true if no task is queued or running.
+ */
+bool TaskQueue::isEmpty() const
+{
+    return (m_queued == 0) && (m_runningCount == 0);
+}
+
+/*! Returns the number of queued tasks.
+ */
+int TaskQueue::queuedCount() const
+{
+    return m_queued;
+}
+
+/*! Returns the number of running tasks.
+ */
+int TaskQueue::runningCount() const
+{
+    return m_runningCount;
+}
+
+/*! Returns the number of destinations in the ready list.
+ */
+int TaskQueue::readyCount() const
+{
+    return m_ready.size();
+}
+
+/*! Returns the number of tasks which can be added to the queue of \p dst
+    without replacing queued tasks.
+ */
+int TaskQueue::freeCount(quint64 dst) const
+{
+    int count = qMin(TASK_MAX_QUEUED - m_queued, (int)m_free.size());
+    QHash<quint64, TaskDestination>::const_iterator d = m_destinations.constFind(dst);
+
+    if (d != m_destinations.constEnd())
+    {
+        count = qMin(count, TASK_MAX_PER_DESTINATION - d->count);
+    }
+
+    return qMax(count, 0);
+}
+
+/*! Returns the number of running tasks which expired without confirm.
+ */
+int TaskQueue::expiredCount() const
+{
+    return m_expired;
+}
+
+/*! Returns the number of tasks which may run at the same time.
+ */
+int TaskQueue::window() const
+{
+    return (int)m_window;
+}
+
+/*! Returns the smoothed confirm latency in ms, 0 if unknown.
+ */
+qint64 TaskQueue::roundTripTime() const
+{
+    return m_srtt;
+}
+
+/*! Additive increase, the window grows by one per window of confirms.
+ */
+void TaskQueue::increaseWindow()
+{
+    if (m_window < TASK_MAX_RUNNING)
+    {
+        m_window += 1.0 / m_window;
+
+        if (m_window > TASK_MAX_RUNNING)
+        {
+            m_window = TASK_MAX_RUNNING;
+        }
+    }
+}
+
+/*! Multiplicative decrease, at most once per round trip time
+    so that one burst of failures doesn't collapse the window.
+ */
+void TaskQueue::decreaseWindow(const char *reason)
+{
+    qint64 now = m_clock.elapsed();
+
+    if ((m_lastDecrease != 0) && ((now - m_lastDecrease) < m_srtt))
+    {
+        return;
+    }
+
+    m_lastDecrease = now;
+    m_window /= 2;
+
+    if (m_window < TASK_MIN_RUNNING)
+    {
+        m_window = TASK_MIN_RUNNING;
+    }
+
+    DBG_Printf(DBG_INFO, "Task window decreased to %d (%s), rtt %d ms\n", (int)m_window, reason, (int)m_srtt);
+}
@@ -0,0 +1,187 @@
+/*
+ * Copyright (C) 2013 dresden elektronik ingenieurtechnik gmbh.
+ * All rights reserved.
+ *
+ * The software in this package is published under the terms of the BSD
+ * style license a copy of which has been included with this distribution in
+ * the LICENSE.txt file.
+ *
+ */
+
+#ifndef ZCL_CODEC_H
+#define ZCL_CODEC_H
+
+#include <QByteArray>
+#include <stdint.h>
+#include <string.h>
+
+#define ZCL_HEADER_SIZE 3 // frame control, sequence number, command id
+
+/*! \class ZclEncoder
+
+    Writes the little endian fields of a fixed layout ZCL payload of
+    \p Size bytes directly into a byte buffer.
+
+    The buffer is resized once, its memory is reused if it isn't shared.
+    Field sizes are taken from the argument types, so the caller must pass
+    exactly typed values, e.g. uint16_t for a 16-bit field.
+ */
+template <int Size>
+class ZclEncoder
+{
+public:
+    explicit ZclEncoder(QByteArray &buf) :
+        m_pos(0)
+    {
+        buf.resize(Size);
+        m_data = buf.data();
+    }
+
+    ~ZclEncoder()
+    {
+        Q_ASSERT(m_pos == Size);
+    }
+
+    template <typename T>
+    ZclEncoder &operator<<(T value)
+    {
+        Q_ASSERT(m_pos + (int)sizeof(T) <= Size);
+
+        for (uint i = 0; i < sizeof(T); i++)
+        {
+            m_data[m_pos++] = (char)(value & 0xFF);
+            value = (T)(value >> 8);
+        }
+
+        return *this;
+    }
+
+private:
+    char *m_data;
+    int m_pos;
+};
+
+/*! \class ZclDecoder
+
+    Reads little endian fields of a ZCL payload.
+
+    Reading past the end yields 0 and clears the ok flag, so a frame can be
+    decoded first and checked once with isOk().
+ */
+class ZclDecoder
+{
+public:
+    explicit ZclDecoder(const QByteArray &buf) :
+        m_data(buf.constData()),
+        m_size(buf.size()),
+        m_pos(0),
+        m_ok(true)
+    {
+    }
+
+    template <typename T>
+    ZclDecoder &operator>>(T &value)
+    {
+        value = 0;
+
+        if ((m_pos + (int)sizeof(T)) > m_size)
+        {
+            m_pos = m_size;
+            m_ok = false;
+            return *this;
+        }
+
+        for (uint i = 0; i < sizeof(T); i++)
+        {
+            value |= (T)((T)(uint8_t)m_data[m_pos++] << (8 * i));
+        }
+
+        return *this;
+    }
+
+    bool isOk() const { return m_ok; }
+    bool atEnd() const { return m_pos >= m_size; }
+
+private:
+    const char *m_data;
+    int m_size;
+    int m_pos;
+    bool m_ok;
+};
+
+/*! Writes a ZCL frame without manufacturer code into a byte buffer.
+    The buffer is resized once, its memory is reused if it isn't shared.
+    \param buf - the buffer, e.g. the ASDU of a request
+    \param frameControl - the ZCL frame control field
+    \param seq - the ZCL sequence number
+    \param commandId - the ZCL command id
+    \param payload - the ZCL payload
+ */
+inline void zclWriteFrame(QByteArray &buf, uint8_t frameControl, uint8_t seq, uint8_t commandId, const QByteArray &payload)
+{
+    buf.resize(ZCL_HEADER_SIZE + payload.size());
+
+    char *data = buf.data();
+    data[0] = (char)frameControl;
+    data[1] = (char)seq;
+    data[2] = (char)commandId;
+
+    if (!payload.isEmpty())
+    {
+        memcpy(data + ZCL_HEADER_SIZE, payload.constData(), payload.size());
+    }
+}
+
+/*! Returns the size in bytes of a fixed length ZCL data type.
+    \param dataType - the ZCL data type id
+    \return the size or 0 for variable length and unknown data types
+ */
+inline int zclDataTypeSize(uint8_t dataType)
+{
+    switch (dataType)
+    {
+    case 0x08: // 8-bit data
+    case 0x10: // boolean
+    case 0x18: // 8-bit bitmap
+    case 0x20: // unsigned 8-bit integer
+    case 0x28: // signed 8-bit integer
+    case 0x30: // 8-bit enumeration
+        return 1;
+
+    case 0x09: // 16-bit data
+    case 0x19: // 16-bit bitmap
+    case 0x21: // unsigned 16-bit integer
+    case 0x29: // signed 16-bit integer
+    case 0x31: // 16-bit enumeration
+    case 0x38: // semi-precision
+    case 0xE8: // cluster id
+    case 0xE9: // attribute id
+        return 2;
+
+    case 0x0A: // 24-bit data
+    case 0x1A: // 24-bit bitmap
+    case 0x22: // unsigned 24-bit integer
+    case 0x2A: // signed 24-bit integer
+        return 3;
+
+    case 0x0B: // 32-bit data
+    case 0x1B: // 32-bit bitmap
+    case 0x23: // unsigned 32-bit integer
+    case 0x2B: // signed 32-bit integer
+    case 0x39: // single precision
+    case 0xE0: // time of day
+    case 0xE1: // date
+    case 0xE2: // UTC time
+        return 4;
+
+    case 0xF0: // IEEE address
+        return 8;
+
+    default:
+        break;
+    }
+
+    return 0;
+}
+
+#endif // ZCL_CODEC_H
@@ -13,6 +13,19 @@
 #include "de_web_plugin.h"
 #include "de_web_plugin_private.h"
 #include "colorspace.h"
+#include "zcl_codec.h"
+
+/*! Writes the ZCL frame of \p task into its ASDU.
+    The ASDU buffer is reused instead of being rebuilt by a QDataStream.
+ */
+static void writeTaskFrame(TaskItem &task)
+{
+    zclWriteFrame(task.req.asdu(),
+                  task.zclFrame.frameControl(),
+                  task.zclFrame.sequenceNumber(),
+                  task.zclFrame.commandId(),
+                  task.zclFrame.payload());
+}
 
 /*!
  * Add a OnOff task to the queue
@@ -36,10 +49,8 @@ bool DeRestPluginPrivate::addTaskSetOnOff(TaskItem &task, bool on)
                              deCONZ::ZclFCDirectionClientToServer |
                              deCONZ::ZclFCDisableDefaultResponse);
 
-    task.req.asdu().clear(); // cleanup old request data if there is any
-    QDataStream stream(&task.req.asdu(), QIODevice::WriteOnly);
-    stream.setByteOrder(QDataStream::LittleEndian);
-    task.zclFrame.writeToStream(stream);
+    task.zclFrame.payload().clear(); // no payload, the task might be reused
+    writeTaskFrame(task);
 
     return addTask(task);
 }
@@ -74,19 +85,12 @@ bool DeRestPluginPrivate::addTaskSetBrightness(TaskItem &task, uint8_t bri, bool
                              deCONZ::ZclFCDisableDefaultResponse);
 
     { // payload
-        QDataStream stream(&task.zclFrame.payload(), QIODevice::WriteOnly);
-        stream.setByteOrder(QDataStream::LittleEndian);
-
+        ZclEncoder<3> stream(task.zclFrame.payload());
         stream << task.level;
         stream << task.transitionTime;
     }
 
-    { // ZCL frame
-        task.req.asdu().clear(); // cleanup old request data if there is any
-        QDataStream stream(&task.req.asdu(), QIODevice::WriteOnly);
-        stream.setByteOrder(QDataStream::LittleEndian);
-        task.zclFrame.writeToStream(stream);
-    }
+    writeTaskFrame(task);
 
     return addTask(task);
 }
@@ -131,21 +135,14 @@ bool DeRestPluginPrivate::addTaskSetEnhancedHue(TaskItem &task, uint16_t hue)
                              deCONZ::ZclFCDisableDefaultResponse);
 
     { // payload
-        QDataStream stream(&task.zclFrame.payload(), QIODevice::WriteOnly);
-        stream.setByteOrder(QDataStream::LittleEndian);
-
+        ZclEncoder<5> stream(task.zclFrame.payload());
         uint8_t direction = 0x00;
         stream << task.enhancedHue;
         stream << direction;
         stream << task.transitionTime;
     }
 
-    { // ZCL frame
-        task.req.asdu().clear(); // cleanup old request data if there is any
-        QDataStream stream(&task.req.asdu(), QIODevice::WriteOnly);
-        stream.setByteOrder(QDataStream::LittleEndian);
-        task.zclFrame.writeToStream(stream);
-    }
+    writeTaskFrame(task);
 
     return addTask(task);
 }
@@ -178,19 +175,12 @@ bool DeRestPluginPrivate::addTaskSetSaturation(TaskItem &task, uint8_t sat)
                              deCONZ::ZclFCDisableDefaultResponse);
 
     { // payload
-        QDataStream stream(&task.zclFrame.payload(), QIODevice::WriteOnly);
-        stream.setByteOrder(QDataStream::LittleEndian);
-
+        ZclEncoder<3> stream(task.zclFrame.payload());
         stream << task.sat;
         stream << task.transitionTime;
     }
 
-    { // ZCL frame
-        task.req.asdu().clear(); // cleanup old request data if there is any
-        QDataStream stream(&task.req.asdu(), QIODevice::WriteOnly);
-        stream.setByteOrder(QDataStream::LittleEndian);
-        task.zclFrame.writeToStream(stream);
-    }
+    writeTaskFrame(task);
 
     return addTask(task);
 }
@@ -227,20 +217,13 @@ bool DeRestPluginPrivate::addTaskSetHueAndSaturation(TaskItem &task, uint8_t hue
                              deCONZ::ZclFCDisableDefaultResponse);
 
     { // payload
-        QDataStream stream(&task.zclFrame.payload(), QIODevice::WriteOnly);
-        stream.setByteOrder(QDataStream::LittleEndian);
-
+        ZclEncoder<4> stream(task.zclFrame.payload());
         stream << task.hue;
         stream << task.sat;
         stream << task.transitionTime;
     }
 
-    { // ZCL frame
-        task.req.asdu().clear(); // cleanup old request data if there is any
-        QDataStream stream(&task.req.asdu(), QIODevice::WriteOnly);
-        stream.setByteOrder(QDataStream::LittleEndian);
-        task.zclFrame.writeToStream(stream);
-    }
+    writeTaskFrame(task);
 
     return addTask(task);
 }
@@ -334,20 +317,13 @@ bool DeRestPluginPrivate::addTaskSetXyColor(TaskItem &task, double x, double y)
                              deCONZ::ZclFCDisableDefaultResponse);
 
     { // payload
-        QDataStream stream(&task.zclFrame.payload(), QIODevice::WriteOnly);
-        stream.setByteOrder(QDataStream::LittleEndian);
-
+        ZclEncoder<6> stream(task.zclFrame.payload());
         stream << task.colorX;
         stream << task.colorY;
         stream << task.transitionTime;
     }
 
-    { // ZCL frame
-        task.req.asdu().clear(); // cleanup old request data if there is any
-        QDataStream stream(&task.req.asdu(), QIODevice::WriteOnly);
-        stream.setByteOrder(QDataStream::LittleEndian);
-        task.zclFrame.writeToStream(stream);
-    }
+    writeTaskFrame(task);
 
     return addTask(task);
 }
@@ -374,20 +350,13 @@ bool DeRestPluginPrivate::addTaskAddToGroup(TaskItem &task, uint16_t groupId)
                              deCONZ::ZclFCDisableDefaultResponse);
 
     { // payload
-        QDataStream stream(&task.zclFrame.payload(), QIODevice::WriteOnly);
-        stream.setByteOrder(QDataStream::LittleEndian);
-
+        ZclEncoder<3> stream(task.zclFrame.payload());
         stream << task.groupId;
         uint8_t cstrlen = 0;
         stream << cstrlen; // mandatory parameter
     }
 
-    { // ZCL frame
-        task.req.asdu().clear(); // cleanup old request data if there is any
-        QDataStream stream(&task.req.asdu(), QIODevice::WriteOnly);
-        stream.setByteOrder(QDataStream::LittleEndian);
-        task.zclFrame.writeToStream(stream);
-    }
+    writeTaskFrame(task);
 
     return addTask(task);
 }
@@ -414,18 +383,11 @@ bool DeRestPluginPrivate::addTaskRemoveFromGroup(TaskItem &task, uint16_t groupI
                              deCONZ::ZclFCDisableDefaultResponse);
 
     { // payload
-        QDataStream stream(&task.zclFrame.payload(), QIODevice::WriteOnly);
-        stream.setByteOrder(QDataStream::LittleEndian);
-
+        ZclEncoder<2> stream(task.zclFrame.payload());
         stream << task.groupId;
     }
 
-    { // ZCL frame
-        task.req.asdu().clear(); // cleanup old request data if there is any
-        QDataStream stream(&task.req.asdu(), QIODevice::WriteOnly);
-        stream.setByteOrder(QDataStream::LittleEndian);
-        task.zclFrame.writeToStream(stream);
-    }
+    writeTaskFrame(task);
 
     return addTask(task);
 }
@@ -452,19 +414,12 @@ bool DeRestPluginPrivate::addTaskAddScene(TaskItem &task, uint16_t groupId, uint
                              deCONZ::ZclFCDisableDefaultResponse);
 
     { // payload
-        QDataStream stream(&task.zclFrame.payload(), QIODevice::WriteOnly);
-        stream.setByteOrder(QDataStream::LittleEndian);
-
+        ZclEncoder<3> stream(task.zclFrame.payload());
         stream << groupId;
         stream << sceneId;
     }
 
-    { // ZCL frame
-        task.req.asdu().clear(); // cleanup old request data if there is any
-        QDataStream stream(&task.req.asdu(), QIODevice::WriteOnly);
-        stream.setByteOrder(QDataStream::LittleEndian);
-        task.zclFrame.writeToStream(stream);
-    }
+    writeTaskFrame(task);
 
     return addTask(task);
 }
@@ -491,19 +446,12 @@ bool DeRestPluginPrivate::addTaskRemoveScene(TaskItem &task, uint16_t groupId, u
                              deCONZ::ZclFCDisableDefaultResponse);
 
     { // payload
-        QDataStream stream(&task.zclFrame.payload(), QIODevice::WriteOnly);
-        stream.setByteOrder(QDataStream::LittleEndian);
-
+        ZclEncoder<3> stream(task.zclFrame.payload());
         stream << groupId;
         stream << sceneId;
     }
 
-    { // ZCL frame
-        task.req.asdu().clear(); // cleanup old request data if there is any
-        QDataStream stream(&task.req.asdu(), QIODevice::WriteOnly);
-        stream.setByteOrder(QDataStream::LittleEndian);
-        task.zclFrame.writeToStream(stream);
-    }
+    writeTaskFrame(task);
 
     return addTask(task);
 }